@@ -2,37 +2,550 @@
 #define CONCURRENT_PROCESSES_H_101182048_101324189
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// how much the marker prints, set at build time with -DMARKER_LOG_LEVEL=<level>
+// anything above the build's level is compiled out, format strings and all, so a quiet build does no printing work at all
+#define MARKER_LOG_QUIET 0   // only errors
+#define MARKER_LOG_INFO 1    // plus what main() does: start up, journal, rubric flushes, TAs finishing
+#define MARKER_LOG_VERBOSE 2 // plus everything every TA does, the default
+
+#ifndef MARKER_LOG_LEVEL
+#define MARKER_LOG_LEVEL MARKER_LOG_VERBOSE
+#endif
+
+// a message that is compiled out still sits behind if (0), so its arguments keep being type checked but are never evaluated
+#if MARKER_LOG_LEVEL >= MARKER_LOG_INFO
+#define LOG_INFO(...) printf(__VA_ARGS__)
+#else
+#define LOG_INFO(...) do { if (0) printf(__VA_ARGS__); } while (0)
+#endif
+
+#if MARKER_LOG_LEVEL >= MARKER_LOG_VERBOSE
+#define LOG_VERBOSE(...) printf(__VA_ARGS__)
+#define LOG_EVENT(...) log_event(__VA_ARGS__)
+#else
+#define LOG_VERBOSE(...) do { if (0) printf(__VA_ARGS__); } while (0)
+#define LOG_EVENT(...) do { if (0) log_event(__VA_ARGS__); } while (0)
+#endif
 
 #define SHARED_RUBRIC "rubric_shm_obj" // name of rubric shared memory object
-#define MAX_RUBRIC_ENTRIES 50          // generic cap on entries up to 50, can be changed
+#define MAX_RUBRIC_ENTRIES 50          // generic cap on entries up to 50, can be changed (at most 64, one dirty bit per entry)
+#define RUBRIC_FILE "rubric/rubric.txt"
+#define RUBRIC_FILE_TMP "rubric/rubric.txt.tmp" // rubric.txt is written here first, then renamed over rubric.txt
+#define RUBRIC_FILE_BACKUP "rubric/rubric.txt.bak" // --bench keeps the original rubric.txt here and renames it back afterwards
+#define DEFAULT_RUBRIC_FLUSH_MS 1000             // how often main() writes rubric corrections to rubric.txt
+
+#define SHARED_EXAM "exam_shm_object" // name of exam table shared memory object, holds a record for every exam file
+
+#define SHARED_WORK_QUEUE "work_queue_shm_obj"   // name of the exam work queue shared memory object
+#define SHARED_TASK_DEQUES "task_deques_shm_obj" // name of the per TA task deques shared memory object
+#define SHARED_SHUTDOWN "shutdown_shm_obj"       // name of the shutdown state shared memory object
+#define TASK_DEQUE_CAPACITY 16                   // a TA only claims a new exam once its deque is empty, so this only has to fit one exam's questions
+
+#define QUESTIONS_PER_EXAM 5                                  // number of questions (status lines) in every exam file
+#define ALL_QUESTIONS_MASK ((1u << QUESTIONS_PER_EXAM) - 1u) // question_status value of a fully marked exam
+
+#define LEASE_DURATION_SECONDS 5         // how long a TA may hold a question before others can take it over, marking takes at most 2 seconds
+#define LEASE_POLL_MICROSECONDS 100000   // how often an idle TA checks for expired leases while other TAs are still marking
+#define LEASE_MIN_MILLISECONDS 200       // leases never get shorter than this however small --time-scale is, it covers the real work of marking
+
+#define SHARED_CLOCK "clock_shm_obj" // name of the simulation clock shared memory object
+
+// how the simulated delays (rubric review, marking, ...) pass, selected with --time-scale and --virtual-time
+#define CLOCK_MODE_REAL 0    // delays are slept, multiplied by the time scale
+#define CLOCK_MODE_VIRTUAL 1 // delays are never slept, they only move the TA's own virtual clock forward
+
+#define VIRTUAL_CLOCK_PARKED (1ULL << 63) // set in a TA's virtual time while it is idle or finished, no other TA waits for it
+
+// return values of claim_question()
+#define CLAIM_FAILED 0    // question is marked or leased by another TA
+#define CLAIM_NEW 1       // question was free and is now leased to us
+#define CLAIM_RECLAIMED 2 // question's lease had expired and is now leased to us
+
+#define MARKING_JOURNAL "marking_journal.bin"              // append-only binary journal of every mark made while TAs run
+#define MARKING_JOURNAL_CHECKPOINT "marking_journal.ckpt"   // how far into the journal the exam files are up to date
+#define MARKING_JOURNAL_FOREIGN "marking_journal.foreign"   // a journal another version of the marker wrote is moved here, never replayed or reset
+#define MARKING_JOURNAL_MAGIC 0x4c4e524au                   // "JRNL" at the start of the marking journal
+#define MARKING_JOURNAL_VERSION 1                           // bumped whenever the layout of journal_record changes
+#define EXAM_FILE_TMP_SUFFIX ".tmp"                         // exam files are written to exams/<exam>.txt.tmp first, then renamed over the exam file
+#define DEFAULT_CHECKPOINT_MS 1000                          // how often main() writes journaled marks into the exam files
+#define SUPERVISOR_POLL_MICROSECONDS 10000                  // how often main() checks on the TAs while they run
+
+// how marks are saved to the exam files, selected with --exam-io=
+#define EXAM_IO_JOURNAL 0 // TAs append to the marking journal, main() writes the exam files at checkpoints and shutdown
+#define EXAM_IO_REWRITE 1 // TAs rewrite the exam file themselves after every mark, under the exam's semaphore stripe
+#define EXAM_IO_MMAP 2    // every exam file is mapped, TAs mark a question with a single byte store into the mapping
+#define EXAM_IO_STORE 3   // exams come from the packed exam store instead of exams/, TAs mark straight into the mapped store
+
+// what main() does instead of marking, selected with --import-exams / --export-exams / --generate-exams=
+#define STORE_COMMAND_NONE 0     // mark exams as usual
+#define STORE_COMMAND_IMPORT 1   // pack every exams/*.txt file into the exam store
+#define STORE_COMMAND_EXPORT 2   // write every record of the exam store back out to exams/*.txt
+#define STORE_COMMAND_GENERATE 3 // fill the exam store with a synthetic pile of exams
+
+// how TAs are run, selected with --threads
+#define TA_MODE_PROCESSES 0 // every TA is a forked process (default)
+#define TA_MODE_THREADS 1   // every TA is a thread of main(), in one address space
 
-#define SHARED_EXAM "exam_shm_object" // name of exam shared memory object, will have # appended to end to signify which exam specifically
-#define MAX_EXAM_ENTRIES 50           // generic cap on entries up to 50, can be changed
+// where TAs run, selected with --pin=
+#define PIN_NONE 0       // TAs run wherever the scheduler puts them (default)
+#define PIN_COMPACT 1    // fill one socket core by core before the next
+#define PIN_SCATTER 2    // spread TAs over every socket and core
+#define PIN_LIST 3       // pin TA n to the n-th CPU of a list
+#define PIN_MAX_CPUS 256 // most CPUs one --pin= list can hold
+
+#define BENCH_MAX_PILES 16        // most pile sizes one --bench-exams= list can hold
+#define BENCH_DEFAULT_EXAMS 1000  // pile size benchmarked when no --bench-exams= is given
+#define BENCH_SEED 4001           // every benchmark run uses this seed, so runs only differ in their TA count and pile
+#define BENCH_FORMAT_CSV 0        // one header line, then one line per run
+#define BENCH_FORMAT_JSON 1       // one JSON object per run, one per line
+
+#define EXAM_STORE "exams.bin"           // packed binary exam store, one header and a fixed size record per exam
+#define EXAM_STORE_TMP "exams.bin.tmp"   // the exam store is written here first, then renamed over EXAM_STORE
+#define EXAM_STORE_BACKUP "exams.bin.bak" // --bench moves the original exam store here and renames it back afterwards
+#define EXAM_STORE_MAGIC 0x534d5845u     // "EXMS" at the start of the exam store
+#define EXAM_STORE_VERSION 2             // bumped whenever the layout of exam_store_record changes
+#define EXAM_STORE_NAME_LENGTH 32        // room for the exam file name (without .txt) in every record
+
+#define EXAM_NAME_ARENA_INITIAL 4096 // starting size of the block list_exams() keeps the exam names in, it doubles whenever it is full
+#define DIRECTORY_READ_BUFFER 65536   // bytes of directory entries list_exams() asks getdents64() for at a time
+
+#define EXAM_FILE_STATUS_OFFSET 5 // the status of question q is the byte at EXAM_FILE_STATUS_OFFSET + 2 * q, after the "NNNN\n" student number
+
+#define SHARED_EVENT_LOG "event_log_shm_obj" // name of the event log shared memory object, one event ring per TA
+#define EVENT_RING_CAPACITY 4096              // events per TA ring, a power of two so head and tail can simply keep counting up
+#define EVENT_RING_FULL_YIELDS 1000           // how many times a TA yields to the logger when its ring is full before dropping the event
+#define EVENT_LOG_POLL_MICROSECONDS 1000      // how often the logger checks the rings when they were all empty
+#define EVENT_LOG_STDOUT_BUFFER 65536         // the logger buffers this much output before writing it
+
+// how the logger prints events, selected with --log-format=
+#define LOG_FORMAT_TEXT 0 // the same lines TAs used to print themselves
+#define LOG_FORMAT_JSON 1 // one JSON object per line
+
+// types of events TAs push onto their ring, value and detail hold the event specific values listed
+#define EVENT_RUBRIC_REVIEW 1         // TA started reviewing the rubric
+#define EVENT_RUBRIC_LOCKED 2         // value: pid of the TA
+#define EVENT_RUBRIC_FIXED 3          // value: old rubric text, detail: corrected rubric text
+#define EVENT_RUBRIC_WRAPPED 4        // corrected rubric text went past the last printable character
+#define EVENT_RUBRIC_PUBLISHED 5      // value: new rubric version
+#define EVENT_RUBRIC_UNLOCKED 6       // value: pid of the TA
+#define EVENT_RUBRIC_OK 7             // value: rubric text that was found correct
+#define EVENT_EXAM_LOADED 8           // TA claimed an exam, value: number of questions queued
+#define EVENT_QUESTION_TAKEN_OVER 9   // question was never started or its lease expired
+#define EVENT_QUESTION_MARKED 10      // value: rubric text used, detail: rubric version used
+#define EVENT_STALE_RUBRIC 11         // value: rubric version used, detail: latest rubric version
+#define EVENT_MARK_SAVED 12           // value: exam I/O mode the mark was saved with
+#define EVENT_EXAM_LOCKED 13          // value: semaphore stripe, detail: pid of the TA
+#define EVENT_EXAM_UNLOCKED 14        // value: semaphore stripe, detail: pid of the TA
+#define EVENT_EXAM_MARKED 15          // every question on the exam is marked
+#define EVENT_EXAM_LOCK_REPAIRED 16   // the TA holding the exam lock died, value: semaphore stripe, detail: exam files rewritten
+#define EVENT_RUBRIC_LOCK_REPAIRED 17 // the TA holding the rubric lock died, value: entries repaired, detail: rubric version published
+#define EVENT_TA_STARTED 18           // value: PID of the TA process or thread ID of the TA thread, detail: 1 for a TA thread
+#define EVENT_QUESTION_STARTED 19     // TA started marking a question
+#define EVENT_SHUTDOWN_REQUESTED 20   // TA reached student number 9999 and set the shutdown flag
+
+#define SHARED_STATS "stats_shm_obj"   // name of the latency statistics shared memory object, one set of histograms per TA
+#define HISTOGRAM_SUB_BUCKET_BITS 3       // every power of two range is split into 2^HISTOGRAM_SUB_BUCKET_BITS buckets, so values are kept within 12.5%
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS) // enough buckets for any 64 bit value
+
+// latencies recorded in the statistics block, every TA has one histogram of each
+#define STAT_SEMAPHORE_WAIT 0        // waitSemaphore() waiting for an exam's semaphore stripe
+#define STAT_EXAM_LOCK_HOLD 1        // exam's semaphore stripe held while the exam file is rewritten
+#define STAT_RUBRIC_LOCK_WAIT 2      // waiting for the rubric lock to correct an entry
+#define STAT_RUBRIC_LOCK_HOLD 3      // rubric lock held while an entry is corrected and published
+#define STAT_EXAM_LOADING 4          // claiming an exam and queueing its questions on the TA's deque
+#define STAT_LOAD_EXAM 5             // load_exam() reading an exam file at startup, recorded by main()
+#define STAT_CORRECT_HARDCOPY_EXAM 6 // correct_hardcopy_exam() rewriting an exam file
+#define STAT_MARK_QUESTION 7         // mark_question(), including the marking delay
+#define STAT_EXAM_END_TO_END 8       // from the exam being claimed to its last question being marked
+#define STAT_METRIC_COUNT 9
 
 #define SEMAOPHORE_KEY 20254001 // key for semaphore for Part 2b
+#define EXAM_LOCK_STRIPES 64    // number of exam locks (semaphores in the set), exams are hashed onto them by index so different exams don't share a lock
+
+#define SHARED_EXAM_LOCKS "exam_locks_shm_obj" // name of the exam locks shared memory object
+#define LOCK_SPINS_BEFORE_YIELD 100            // ticket and MCS waiters spin this many times before giving up the CPU
+#define LOCK_BENCH_MILLISECONDS 250            // how long every --lock-bench run takes
+#define LOCK_OWNER_CHECK_MILLISECONDS 100      // futex waiters check this often whether the TA holding the lock died
+
+// what taking a lock returns
+#define LOCK_ACQUIRED 0   // the lock is ours
+#define LOCK_OWNER_DIED 1 // the lock is ours, but whoever held it before died holding it and what it protects has to be repaired
+#define LOCK_FAILED -1    // the lock is not ours, the caller must stay out of the critical section and not release it
+
+// what waitSemaphore() and signalSemaphore() lock with, selected with --lock=
+#define LOCK_BACKEND_SYSV 0   // a SysV semaphore per stripe, semop() every time (default)
+#define LOCK_BACKEND_FUTEX 1  // a futex word per stripe, atomics when uncontended and the kernel only to sleep and wake
+#define LOCK_BACKEND_TICKET 2 // a ticket lock per stripe, TAs get the lock in the order they asked for it
+#define LOCK_BACKEND_MCS 3    // an MCS queue lock per stripe, every waiting TA spins on its own queue node
+#define LOCK_BACKEND_ROBUST 4 // a robust process-shared pthread mutex per stripe
+#define LOCK_BACKEND_COUNT 5
+
+// One published version of the rubric, what TAs read while marking
+// sequence is odd while the copy is being overwritten, readers retry if it was odd or changed while they read
+typedef struct
+{
+    atomic_uint sequence;
+    unsigned int version; // rubric version held in this copy
+    int entries_loaded;
+    char exam_text[MAX_RUBRIC_ENTRIES];
+} rubric_copy;
 
 // Struct which will contain all contents of the rubric in shared memory
+// exercise_number[], exam_text[] and entries_loaded are the working rubric TAs correct, rubric_lock is a robust process-shared
+// mutex that only one TA at a time can hold to correct it
+// after every correction the working rubric is published into the spare copy and current_version moves to it,
+// TAs marking exams only read the published copies and never take the lock
 typedef struct
 {
+    pthread_mutex_t rubric_lock;
     int exercise_number[MAX_RUBRIC_ENTRIES];
     char exam_text[MAX_RUBRIC_ENTRIES];
     int entries_loaded;
+    atomic_ullong dirty_entries;   // bit i is set when exam_text[i] was corrected and not yet written to rubric.txt
+    atomic_uint current_version;   // latest published version, it lives in copies[current_version % 2]
+    rubric_copy copies[2];
 } rubric_shared_data;
 
 // Struct which will contain all contents of an exam file in shared memory
+// bit q of question_status is set once question q is marked, bit q of question_claimed once a TA has taken it
+// both words are only ever updated with atomic fetch_or, so marking a question needs no lock
+// a question is leased until lease_deadline[q] (monotonic clock, ns), 0 means not leased, the lease is taken with a compare-and-swap of it
 typedef struct
 {
     int student_number;
-    char q1_status;
-    char q2_status;
-    char q3_status;
-    char q4_status;
-    char q5_status;
+    atomic_uint question_status;
+    atomic_uint question_claimed;
+    atomic_ullong lease_deadline[QUESTIONS_PER_EXAM];
+    int lease_owner[QUESTIONS_PER_EXAM];             // TA number holding each lease, for printing purposes
+    unsigned int rubric_version[QUESTIONS_PER_EXAM]; // rubric version each question was marked against, 0 if unmarked or marked on paper
+    unsigned int materialized_status;                // question_status as last written to the exam file, only used by main()
+    atomic_ullong claimed_at_ns;                     // monotonic clock time the exam was claimed from the work queue, 0 until then
     int entries_loaded;
 } exam_file_shared_data;
 
+// Struct which holds every exam in one shared memory object, sized from the number of exam files at startup
+// exams[i] is the record for exam_files[i]
+typedef struct
+{
+    int exam_count;
+    int runnable_count; // exams before the first 9999 sentinel, the only ones TAs are ever given work from
+    exam_file_shared_data exams[];
+} exam_table_shared_data;
+
+// Struct which holds every exam that still has to be handed out to a TA, seeded once by main()
+// next_claim is the shared cursor, TAs atomically bump it to claim the exam at exam_order[next_claim]
+typedef struct
+{
+    atomic_int next_claim;
+    int exam_count;
+    int exam_order[]; // indexes into the exam_files[] array, sized to exam_count when created
+} exam_work_queue;
+
+// Struct which lets the TA that reaches the 9999 sentinel stop the whole run, created once by main() before any TA exists
+// TAs check requested every time before they take on more work, instead of being killed wherever they happen to be
+typedef struct
+{
+    atomic_int requested;             // 1 once a shutdown was requested, the fields below are set before it is
+    atomic_int requested_by;          // number of the TA that requested the shutdown, 0 while none did
+    unsigned long long requested_ns;  // monotonic clock time the shutdown was requested
+    int sentinel_exam;                // index of the exam with student number 9999, found by main() at startup, -1 if there is none
+} shutdown_state;
+
+// A single unit of work, marking one question of one exam
+typedef struct
+{
+    int exam_index; // index into the exam_files[] array
+    int question;   // 0 based question number
+} marking_task;
+
+// Deque of marking tasks owned by one TA, the owner pushes and pops at the head and other TAs steal from the tail
+// head and tail only ever grow, the slot for an index is index % TASK_DEQUE_CAPACITY
+typedef struct
+{
+    pthread_mutex_t deque_lock;
+    int head;
+    int tail;
+    marking_task tasks[TASK_DEQUE_CAPACITY];
+} ta_task_deque;
+
+// Header at the start of the marking journal, a journal written by a build with a different record layout is never replayed
+typedef struct
+{
+    uint32_t magic;       // MARKING_JOURNAL_MAGIC
+    uint32_t version;     // MARKING_JOURNAL_VERSION
+    uint32_t record_size; // sizeof(journal_record) when the journal was started
+    uint32_t reserved;    // always 0
+} journal_header;
+
+// One fixed size record in the marking journal, appended every time a TA marks a question, after the journal_header
+typedef struct
+{
+    int32_t exam_index;      // index into the exam_files[] array
+    int32_t student_number;  // student number on the exam, used to check the record still matches when replaying
+    int32_t question;        // 0 based question number
+    int32_t ta;              // number of the TA who marked the question
+    uint32_t rubric_version; // rubric version the question was marked against
+    uint32_t reserved;       // always 0, keeps timestamp_ns 8 byte aligned without padding
+    uint64_t timestamp_ns;   // wall clock time of the mark
+} journal_record;
+
+// One fixed size record in the exam store, the packed form of one exams/*.txt file
+// the store is mapped MAP_SHARED by every TA, so question_status is updated with atomic fetch_or just like the exam table
+typedef struct
+{
+    char exam_name[EXAM_STORE_NAME_LENGTH];      // exam file name without .txt, i.e., "exam1"
+    int32_t student_number;
+    atomic_uint question_status;                 // bit q is set once question q is marked
+    int32_t marked_by[QUESTIONS_PER_EXAM];       // number of the TA who marked each question, 0 if unmarked or marked before import
+    uint32_t rubric_version[QUESTIONS_PER_EXAM]; // rubric version each question was marked against, 0 if unmarked or marked before import
+} exam_store_record;
+
+// Layout of the exam store file, a header followed by exam_count records
+typedef struct
+{
+    uint32_t magic;       // EXAM_STORE_MAGIC
+    uint32_t version;     // EXAM_STORE_VERSION
+    uint32_t record_size; // sizeof(exam_store_record) when the store was written
+    int32_t exam_count;
+    exam_store_record records[];
+} exam_store;
+
+// Struct which decides how simulated delays pass, created once by main() before any TA exists
+// in virtual time every TA has its own clock that only its own delays move forward
+typedef struct
+{
+    int clock_mode;                       // CLOCK_MODE_REAL or CLOCK_MODE_VIRTUAL
+    double time_scale;                    // real time delays are multiplied by this, 0 means don't sleep at all
+    unsigned long long lease_duration_ns; // how long a question lease lasts, on the real monotonic clock
+    useconds_t lease_poll_microseconds;   // how often an idle TA checks for expired leases
+    int ta_count;
+    atomic_ullong virtual_time_ns[];      // virtual time of each TA, indexed by TA number - 1, may have VIRTUAL_CLOCK_PARKED set
+} simulation_clock;
+
+// State of one TA's random number generator (xoshiro256**), every TA has its own so TAs never share or reseed one
+typedef struct
+{
+    uint64_t state[4];
+} ta_rng;
+
+// One event a TA pushed onto its ring, the logger process turns it into text or JSON
+typedef struct
+{
+    uint64_t timestamp_ns; // monotonic clock time of the event
+    uint16_t type;         // one of the EVENT_ types
+    uint16_t ta;           // number of the TA the event is about
+    int32_t exam_index;    // index into the exam_files[] array, -1 if the event is not about an exam
+    int32_t question;      // 0 based question number, -1 if the event is not about a question
+    int32_t value;         // event specific, see the EVENT_ types
+    int32_t detail;        // event specific, see the EVENT_ types
+    uint32_t reserved;     // always 0, pads the record to 32 bytes
+} event_record;
+
+// Single producer, single consumer ring of events for one TA
+// only the TA moves head and only the logger moves tail, they are on separate cache lines so the two never fight over one
+typedef struct
+{
+    _Alignas(64) atomic_ullong head; // number of events the TA has pushed
+    _Alignas(64) atomic_ullong tail; // number of events the logger has printed
+    atomic_ullong dropped;           // events the TA dropped because the ring was full
+    event_record events[EVENT_RING_CAPACITY];
+} ta_event_ring;
+
+// Struct which holds the event ring of every TA, created once by main() before the logger and TAs exist
+typedef struct
+{
+    int ta_count;
+    atomic_int shutdown; // set by main() once every TA is done, the logger prints what is left and exits
+    ta_event_ring rings[];
+} event_log;
+
+// Log bucketed latency histogram, values are nanoseconds
+// values below HISTOGRAM_SUB_BUCKETS get a bucket each, larger values share a bucket with the values that have the same
+// highest bit and the same HISTOGRAM_SUB_BUCKET_BITS bits below it
+// every histogram has exactly one writer, so the counts are plain integers that main() reads once that writer is gone
+typedef struct
+{
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+} latency_histogram;
+
+// One histogram of every STAT_ latency, for one TA or for main()
+typedef struct
+{
+    unsigned long long finished_ns; // monotonic clock time the TA ran out of work, 0 for main() or if the TA never got there
+    int pinned_cpu;                 // CPU the TA was pinned to, -1 if it was not pinned
+    int started_cpu;                // CPU the TA started on
+    int finished_cpu;               // CPU the TA ran out of work on
+    latency_histogram metrics[STAT_METRIC_COUNT];
+} latency_stats;
+
+// Struct which holds the latency histograms of every TA, created once by main() before any TA exists
+// sets[0] belongs to main(), sets[ta] to TA number ta
+typedef struct
+{
+    int ta_count;
+    unsigned long long marking_started_ns; // monotonic clock time main() started creating TAs
+    latency_stats sets[];
+} stats_block;
+
+// What one benchmark run measured, one line of the benchmark report
+typedef struct
+{
+    int exam_count;
+    int questions_to_mark;   // unmarked questions on every exam of the pile
+    int ta_count;
+    double seconds;          // from the first TA being created to the last one exiting
+    int exams_marked;        // exams that were fully marked when the run ended
+    long long marks;         // questions marked during the run
+    double rubric_lock_wait_share; // time TAs spent waiting for the rubric lock, as a share of all TA time (--exam-io=store takes no exam locks)
+    int stopped_by_sentinel; // 1 if the run ended early on the 9999 student number
+} bench_result;
+
+// One directory entry as getdents64() returns it, glibc has no type for it
+typedef struct
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen; // size of this whole entry, the next one starts right after it
+    unsigned char d_type;    // DT_REG for regular files, DT_UNKNOWN if the file system doesn't say
+    char d_name[];
+} linux_dirent64;
+
+// One exam lock stripe, which fields are used depends on the lock backend, every stripe has a cache line to itself
+typedef struct
+{
+    _Alignas(64) atomic_uint futex_word; // LOCK_BACKEND_FUTEX: 0 unlocked, else pid of the holder, with FUTEX_WAITERS if somebody may be sleeping on it
+    atomic_uint next_ticket;             // LOCK_BACKEND_TICKET: ticket the next TA to ask gets
+    atomic_uint now_serving;             // LOCK_BACKEND_TICKET: ticket that holds the lock
+    atomic_int mcs_tail;                 // LOCK_BACKEND_MCS: TA index + 1 of the last TA in the queue, 0 if the lock is free
+    atomic_int owner_pid;                // LOCK_BACKEND_SYSV: pid of the holder, 0 while unlocked, left behind if the holder died
+    pthread_mutex_t robust_mutex;        // LOCK_BACKEND_ROBUST: robust process-shared mutex
+} exam_lock;
+
+// One TA's node in MCS queues, a TA only ever waits for one exam lock at a time so one node per TA is enough
+typedef struct
+{
+    _Alignas(64) atomic_int next; // TA index + 1 of the TA queued behind this one, 0 if none yet
+    atomic_int locked;            // 1 while the TA waits, the TA ahead of it sets it to 0 to hand over the lock
+} mcs_node;
+
+// Struct which holds every exam lock, created once by main() before any TA exists
+typedef struct
+{
+    int backend;      // one of the LOCK_BACKEND_ values
+    int semaphore_id; // LOCK_BACKEND_SYSV: ID of the semaphore set, one semaphore per stripe, -1 otherwise
+    int ta_count;
+    atomic_int lock_failures; // times waitSemaphore() returned LOCK_FAILED, main() rewrites every stale exam file if there were any
+    exam_lock stripes[EXAM_LOCK_STRIPES];
+    mcs_node mcs_nodes[]; // one per TA, indexed by TA index
+} exam_lock_set;
+
+// What one --lock-bench run measured
+typedef struct
+{
+    int backend;
+    int process_count;
+    double seconds;
+    long long acquisitions;     // times the lock was taken by all processes together
+    long long min_acquisitions; // times the least lucky process took it
+    long long max_acquisitions; // times the luckiest process took it
+    double fairness;            // Jain's fairness index of the acquisitions, 1 is perfectly fair
+    int exclusive;              // 1 if the counter the lock protects came out right
+} lock_bench_result;
+
+// How many times one --lock-bench process took the lock, on a cache line of its own
+typedef struct
+{
+    _Alignas(64) long long acquisitions;
+} lock_bench_counter;
+
+// Shared by the processes of one --lock-bench run
+typedef struct
+{
+    atomic_int ready;            // processes waiting at the start line
+    atomic_int start;
+    atomic_int stop;
+    long long protected_counter; // only ever changed while holding the lock
+    lock_bench_counter counters[];
+} lock_bench_shared;
+
+// One CPU the TAs may be pinned to, with where it sits in the machine
+typedef struct
+{
+    int cpu;
+    int package;     // socket the CPU is on
+    int core;        // core the CPU is on, hyperthreads of one core share it
+    int spread_rank; // only used to sort CPUs in scatter order
+} cpu_slot;
+
+// Options the marker was started with, filled in by parse_arguments()
+typedef struct
+{
+    int number_of_tas;
+    int exam_io_mode;                       // one of the EXAM_IO_ modes
+    int checkpoint_ms;                      // interval between journal checkpoints
+    int rubric_flush_ms;                    // interval between rubric.txt flushes
+    int msync_marks;                        // mmap mode only, msync() after every mark
+    int store_command;                      // STORE_COMMAND_NONE, or import/export/generate the exam store and exit
+    double time_scale;                      // simulated delays are multiplied by this, 0 means no sleeping
+    int virtual_time;                       // 1 to pass simulated delays in virtual time instead of sleeping
+    uint64_t seed;                          // run seed, every TA seeds its random number generator from it and its TA number
+    int log_format;                         // LOG_FORMAT_TEXT or LOG_FORMAT_JSON
+    int generate_exam_count;                // with STORE_COMMAND_GENERATE, how many exams the synthetic pile holds
+    int questions_to_mark;                  // questions left unmarked on every generated exam, the rest start out marked
+    int sentinel_at;                        // index of the generated exam with student number 9999, -1 for none
+    int bench_max_tas;                      // 0 to mark as usual, otherwise benchmark 1 to bench_max_tas TAs and exit
+    int bench_pile_count;
+    int bench_exam_counts[BENCH_MAX_PILES]; // pile sizes to benchmark
+    int bench_format;                       // BENCH_FORMAT_CSV or BENCH_FORMAT_JSON
+    int ta_mode;                            // TA_MODE_PROCESSES or TA_MODE_THREADS
+    int pin_policy;                         // one of the PIN_ policies
+    int pin_cpu_count;
+    int pin_cpus[PIN_MAX_CPUS];             // with PIN_LIST, the CPU of every TA in turn
+    int lock_backend;                       // one of the LOCK_BACKEND_ values
+    int lock_bench_max_tas;                 // 0 to mark as usual, otherwise benchmark every lock backend with up to this many processes and exit
+} marker_options;
+
+// Everything a TA needs to mark exams, the same whether the TA is a forked process or a thread
+typedef struct
+{
+    int ta_index;       // 0 based, the TA's number is ta_index + 1
+    int num_ta_processes;
+    rubric_shared_data *rubric;
+    exam_table_shared_data *table;
+    exam_work_queue *queue;
+    ta_task_deque *deques;
+    char **exam_files;
+    exam_lock_set *exam_locks;
+    int journal_fd;     // only used in EXAM_IO_JOURNAL mode
+    char **exam_maps;   // only used in EXAM_IO_MMAP mode
+    exam_store *store;  // only used in EXAM_IO_STORE mode
+    simulation_clock *clock;
+    event_log *events;
+    stats_block *stats;
+    shutdown_state *shutdown;
+    const int *ta_cpus; // CPU every TA is pinned to, indexed by TA index, NULL if TAs are not pinned
+    const marker_options *options;
+} ta_context;
+
+// One TA thread, created by create_ta_threads() when the marker runs with --threads
+typedef struct
+{
+    pthread_t thread;
+    ta_context context;
+    atomic_int finished; // set by the thread once run_ta() returns, so main() knows joining it won't block
+    int joined;          // set once main() has joined the thread
+} ta_thread;
+
 /**
  * @brief Create a hared Memory Rubric object with size sizeof(rubric_shared_data) struct
  *
@@ -40,6 +553,74 @@ typedef struct
  */
 rubric_shared_data *createSharedMemRubric();
 
+/**
+ * @brief Lock a robust process-shared mutex, noticing if the process holding it died
+ * When the owner of a robust mutex dies the kernel hands it to the next process that locks it, with EOWNERDEAD instead of 0.
+ * The mutex is marked consistent again right away, the caller holds it and has to repair whatever it protects
+ *
+ * @param mutex The robust mutex to lock
+ * @return int LOCK_ACQUIRED, or LOCK_OWNER_DIED if the previous owner died holding it
+ */
+int lock_robust_mutex(pthread_mutex_t *mutex);
+
+/**
+ * @brief Take the rubric lock, only one TA (or main() flushing the rubric) can hold it
+ * TAs marking exams read the published copies and never take it, so there is no need for it to be a reader-writer lock
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return int LOCK_ACQUIRED, or LOCK_OWNER_DIED if a TA died holding it and the caller has to call repair_rubric()
+ */
+int lockRubric(rubric_shared_data *rubric);
+
+/**
+ * @brief Release the rubric lock
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ */
+void unlockRubric(rubric_shared_data *rubric);
+
+/**
+ * @brief Look up the rubric text for a single exercise in the latest published copy of the rubric
+ * This takes no lock and writes nothing to shared memory, if a TA overwrites the copy while we read it we just read again
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @param exam_q_to_mark The question (0 based) we want the rubric entry for
+ * @param rubric_version Where to store the version of the rubric the entry was read from
+ * @return char The rubric text for that exercise, or '?' if the rubric has no such entry
+ */
+char read_rubric_entry(rubric_shared_data *rubric, int exam_q_to_mark, unsigned int *rubric_version);
+
+/**
+ * @brief Publish the working rubric as a new version that TAs marking exams will read from
+ * The new version is written into the spare copy, so readers of the current version are never disturbed,
+ * then current_version moves to it in a single atomic store. Must be called with the rubric lock held for writing
+ * (or before any TA exists)
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return unsigned int The version that was published
+ */
+unsigned int publish_rubric(rubric_shared_data *rubric);
+
+/**
+ * @brief Bring the rubric back to a consistent state after a TA died holding the rubric lock
+ * The TA may have died half way through a correction or a publish: a copy left with an odd sequence is made even again,
+ * an entry bumped past the last printable character gets the wrap the TA never did, every entry is marked dirty so the
+ * next flush rewrites all of rubric.txt, and the working rubric is published again. Must be called with the rubric lock held
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @param version Where to store the rubric version that was published
+ * @return int Number of rubric entries that had to be fixed
+ */
+int repair_rubric(rubric_shared_data *rubric, unsigned int *version);
+
+/**
+ * @brief Get the latest published rubric version
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return unsigned int The latest published rubric version, starting at 1 once rubric.txt is loaded
+ */
+unsigned int published_rubric_version(rubric_shared_data *rubric);
+
 /**
  * @brief Read the contents of rubric.txt into the shared memory rubric
  *
@@ -49,23 +630,42 @@ rubric_shared_data *createSharedMemRubric();
 rubric_shared_data *load_rubric(rubric_shared_data *rubric);
 
 /**
- * @brief Create a Shared Memory Exam object with size sizeof(exam_file_shared_data) struct
+ * @brief Create the Shared Memory Exam table with one exam_file_shared_data record for every exam file
+ * The table is mapped once at startup and indexed the same as the exam_files[] array
+ *
+ * @param exam_count Number of exams the table needs to hold
+ * @return *exam_table_shared_data A pointer to the exam table in shared memory
+ */
+exam_table_shared_data *createSharedMemExam(int exam_count);
+
+/**
+ * @brief Size in bytes of an exam table holding exam_count records
  *
- * @param exam_shm_name The name of the shared memory exam we want to create
- * @return *xam_file_shared_data A pointer to the shared memory exam object
+ * @param exam_count Number of exams in the table
+ * @return size_t Size of the header plus every record
  */
-exam_file_shared_data *createSharedMemExam(char *exam_shm_name);
+size_t exam_table_size(int exam_count);
 
 /**
- * @brief Read the contents of exam1.txt into the shared memory exam object
+ * @brief Read the contents of an exam file into its record in the shared memory exam table
  *        (struct holds a single student_number as char, status of each individual question (0 = unmarked, 1 = marked,) and entries_loaded)
  *
- * @param exam A pointer to shared memory exam object we want to load with data
+ * @param exam A pointer to the shared memory exam record we want to load with data
  * @param exam_file_name The name of the exam file we want to load into shared memory from exams/ dir
- * @param ta_num The number of the TA responsible for loading the exam
  * @return *exam_file_shared_data A pointer to the loaded exam in shared memory
  */
-exam_file_shared_data *load_exam(exam_file_shared_data *exam, const char *exam_file_name, int ta_num);
+exam_file_shared_data *load_exam(exam_file_shared_data *exam, const char *exam_file_name);
+
+/**
+ * @brief Load every exam file in exams/ into its record in the shared memory exam table
+ * This happens once in main() before any TA is created, so TAs never read exam files themselves
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/, the record for exam_files[i] is table->exams[i]
+ * @param stats main()'s set of latency histograms, every load_exam() is recorded in it
+ * @return int 0 on success, -1 if any exam could not be loaded
+ */
+int load_exam_table(exam_table_shared_data *table, char **exam_files, latency_stats *stats);
 
 /**
  * @brief Access the rubric in shared memory
@@ -75,133 +675,1111 @@ exam_file_shared_data *load_exam(exam_file_shared_data *exam, const char *exam_f
 rubric_shared_data *accessSharedMemRubric();
 
 /**
- * @brief Access the exam stored in shared memory
+ * @brief Access the exam table stored in shared memory
+ *
+ * @return *exam_table_shared_data A pointer to the exam table in shared memory
+ */
+exam_table_shared_data *accessSharedMemExam();
+
+/**
+ * @brief Create the Shared Memory Work Queue object, sized to hold one slot for every exam
+ *
+ * @param exam_count Number of exams the queue needs to hold
+ * @return *exam_work_queue A pointer to the work queue in shared memory
+ */
+exam_work_queue *createSharedMemWorkQueue(int exam_count);
+
+/**
+ * @brief Index the student number of every exam, in the order exams are handed out, to find where the 9999 sentinel cuts the pile off
+ * Every exam before the first sentinel is the runnable prefix, it is stored in the exam table and is all TAs are ever
+ * given work from, so no TA marks an exam the sentinel cuts off no matter how the TAs happen to be scheduled.
+ * Must be called after the exam table is loaded and before any TA is created
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @return int Index of the sentinel exam in the exam_files[] array, -1 if no exam has student number 9999
+ */
+int find_runnable_prefix(exam_table_shared_data *table);
+
+/**
+ * @brief Fill the work queue with every exam from list_exams(), in the order they should be handed out
+ * Must be called before any TA is created
+ *
+ * @param queue Pointer to the work queue in shared memory
+ * @param exam_count Number of exams to hand out, the runnable prefix of the exam_files[] array
+ */
+void seed_exam_work_queue(exam_work_queue *queue, int exam_count);
+
+/**
+ * @brief Claim the next exam nobody has taken yet
+ * The claim is a single atomic increment of the shared cursor, so every exam is handed to exactly one TA
+ *
+ * @param queue Pointer to the work queue in shared memory
+ * @return int Index of the claimed exam in the exam_files[] array, or -1 once every exam has been claimed
+ */
+int claim_next_exam(exam_work_queue *queue);
+
+/**
+ * @brief Create the Shared Memory Shutdown object, TAs stop taking on work once a TA requests the shutdown in it
+ *
+ * @return *shutdown_state A pointer to the shutdown state in shared memory
+ */
+shutdown_state *createSharedMemShutdown();
+
+/**
+ * @brief Ask every TA to stop, because the exam with student number 9999 was reached
+ * Only the first request counts, it records who asked, for which exam and when, before the requested flag is raised
+ *
+ * @param shutdown Pointer to the shutdown state in shared memory
+ * @param ta Number of the TA asking
+ * @param exam_index Index of the sentinel exam in the exam_files[] array
+ * @return int 1 if this call requested the shutdown, 0 if it was already requested
+ */
+int request_shutdown(shutdown_state *shutdown, int ta, int exam_index);
+
+/**
+ * @brief Check whether the run is shutting down, TAs call this every time before they take on more work
+ *
+ * @param shutdown Pointer to the shutdown state in shared memory
+ * @return int 1 once a shutdown has been requested, 0 otherwise
+ */
+int shutdown_requested(shutdown_state *shutdown);
+
+/**
+ * @brief Print where the 9999 sentinel cut the pile off and, if a TA still reached it, how long the run took to stop
+ * Normally the sentinel is found at startup and no TA has to be stopped, the latency only exists when the shutdown flag was set
+ *
+ * @param shutdown Pointer to the shutdown state in shared memory
+ * @param stats Pointer to the statistics block in shared memory, every TA recorded when it stopped in its own set
+ * @param table Pointer to the exam table in shared memory, for how many exams were cut off
+ * @param exam_files Array of all the exam files in exams/, for the name of the sentinel exam
+ * @param tas_stopped_ns Monotonic clock time main() saw the last TA exit
+ */
+void print_shutdown_latency(shutdown_state *shutdown, stats_block *stats, exam_table_shared_data *table, char **exam_files, unsigned long long tas_stopped_ns);
+
+/**
+ * @brief Create the Shared Memory Task Deques object, one deque of (exam, question) tasks for every TA
+ *
+ * @param num_ta_processes Number of TAs, each one owns a deque
+ * @return *ta_task_deque A pointer to the first deque in shared memory
+ */
+ta_task_deque *createSharedMemTaskDeques(int num_ta_processes);
+
+/**
+ * @brief Lock a TA's deque, repairing the deque if a TA died holding its lock
+ * head and tail are only ever changed one at a time, so all a dead TA can leave behind is a deque with tail past head
+ * or more tasks than fit. Such a deque is emptied, the tasks it held are still leased and reclaim_question() picks them up
+ * once their lease runs out
+ *
+ * @param deque Pointer to the deque to lock
+ */
+void lock_task_deque(ta_task_deque *deque);
+
+/**
+ * @brief Push a task onto the head of a TA's own deque
+ *
+ * @param deque Pointer to the deque owned by the calling TA
+ * @param task The (exam, question) task to push
+ * @return int 1 if the task was pushed, 0 if the deque is full
+ */
+int push_task(ta_task_deque *deque, marking_task task);
+
+/**
+ * @brief Pop the most recently pushed task from the head of a TA's own deque
+ *
+ * @param deque Pointer to the deque owned by the calling TA
+ * @param task Where to store the popped task
+ * @return int 1 if a task was popped, 0 if the deque is empty
+ */
+int pop_task(ta_task_deque *deque, marking_task *task);
+
+/**
+ * @brief Steal the oldest task from the tail of another TA's deque
+ * Victims are tried starting from a random TA so thieves don't all pile onto the same deque
  *
- * @return *exam_file_shared_data A pointer to the exam in shared memory
+ * @param deques Pointer to the first deque in shared memory
+ * @param num_ta_processes Number of TAs (and deques)
+ * @param ta_index Index of the TA doing the stealing, its own deque is skipped
+ * @param rng The stealing TA's random number generator, picks the first victim
+ * @param task Where to store the stolen task
+ * @return int 1 if a task was stolen, 0 if every other deque is empty
  */
-exam_file_shared_data *accessSharedMemExam(char *exam_shm_name);
+int steal_task(ta_task_deque *deques, int num_ta_processes, int ta_index, ta_rng *rng, marking_task *task);
 
 /**
  * @brief Determine if the exam is fully marked
- * It is fully marked is all question status's i.e., q1_status, q2_status, etc, have a value of 1
+ * It is fully marked when every question has its bit set in the status word, so this is a single compare
  *
  * @param exam The exam in shared memory we want to check
- * @param exam_shm_name The name of the exam in shared memory (purely for printing purposes)
  * @return int Status if fully marked or not
  */
-int exam_fully_marked(exam_file_shared_data *exam, char *exam_shm_name);
+int exam_fully_marked(exam_file_shared_data *exam);
 
 /**
- * @brief Helper function to generate a random delay value from 0.5 to 1.0 seconds
+ * @brief Step a splitmix64 generator, only used to spread a seed over the state of a TA's generator
  *
- * @return double Randomly generated delay value from 0.5 to 1.0 seconds
+ * @param state The splitmix64 state, moved forward by one step
+ * @return uint64_t The next splitmix64 output
  */
-double random_delay_value();
+uint64_t splitmix64(uint64_t *state);
 
 /**
- * @brief Helper function to generate a random delay value from 1.0 to 2.0 seconds
- * To simulate the amount of time it takes to correct a question
+ * @brief Seed a TA's random number generator from the run seed and the TA number
+ * The same seed and TA number always give the same sequence, different TAs get unrelated sequences
  *
- * @return double Randomly generated delay value from 1.0 to 2.0 seconds
+ * @param rng The TA's random number generator
+ * @param seed Seed of the whole run, from --seed
+ * @param ta Number of the TA the generator belongs to
  */
-double random_correcting_delay();
+void seed_ta_rng(ta_rng *rng, uint64_t seed, int ta);
 
 /**
- * @brief Function to actually write the rubric corrections to the hardcopy rubric.txt file in the directory
+ * @brief Get the next 64 random bits from a TA's generator (xoshiro256**)
  *
- * @param rubric Pointer to the rubric in shared memory
+ * @param rng The TA's random number generator
+ * @return uint64_t 64 random bits
  */
-void correct_hardcopy_rubric(rubric_shared_data *rubric);
+uint64_t ta_rng_next(ta_rng *rng);
 
 /**
- * @brief Function to check if a rubric line needs to be correct according to random generated num (1 or 0)
- * If the rubric line needs to be correct, increment and ASCII character by 1
- * If the line does not need to be corrected, do nothing to it
+ * @brief Get a random number from 0 to bound - 1 from a TA's generator
  *
- * @param rubric Pointer to the rubric in shared memory
- * @param ta Number of the TA doing the correction for printing purposes
+ * @param rng The TA's random number generator
+ * @param bound How many different values there can be, must be at least 1
+ * @return int Random number from 0 to bound - 1
  */
-void check_and_correct_rubric(rubric_shared_data *rubric, int ta);
+int ta_rng_below(ta_rng *rng, int bound);
 
 /**
- * @brief Check if the exam question is already marked through q<x>_status
- * If question status is 1, it is already marked
- * If question status is 0, it is not yet marked
+ * @brief Get a random number from 0.0 up to (not including) 1.0 from a TA's generator
  *
- * @param exam Pointer to the exam in shared memory
- * @param exam_q_to_mark Specific question to check if it is marked
- * @return int If 1 is returned, question is marked, if 0, not marked
+ * @param rng The TA's random number generator
+ * @return double Random number in [0.0, 1.0)
  */
-int is_exam_q_marked(exam_file_shared_data *exam, int exam_q_to_mark);
+double ta_rng_unit(ta_rng *rng);
 
 /**
- * @brief Now that the question status is checked if it is marked, we can mark it
- * i.e., change its status from 0 to 1
+ * @brief Helper function to generate a random delay value from 0.5 to 1.0 seconds
  *
- * @param exam Pointer to the exam in shared memory
- * @param exam_q_to_mark Specific question to mark
+ * @param rng The calling TA's random number generator
+ * @return double Randomly generated delay value from 0.5 to 1.0 seconds
  */
-void mark_question(exam_file_shared_data *exam, int exam_q_to_mark);
+double random_delay_value(ta_rng *rng);
 
 /**
- * @brief Write the shared memory exam to the actual "harcopy" .txt exam file
+ * @brief Helper function to generate a random delay value from 1.0 to 2.0 seconds
+ * To simulate the amount of time it takes to correct a question
  *
- * @param exam Pointer to the exam in shared memory
- * @param exam_file_name Name of the exam file to write to, i.e., "exam1", "exam2", etc.
- * @param question_to_correct The specific exam question that needs to be modified in the harcopy exam file since it's been corrected
+ * @param rng The calling TA's random number generator
+ * @return double Randomly generated delay value from 1.0 to 2.0 seconds
  */
-void correct_hardcopy_exam(exam_file_shared_data *exam, char *exam_file_name, int question_to_correct);
+double random_correcting_delay(ta_rng *rng);
 
 /**
- * @brief Get an array of exam file names that are contained in the exams/ directory
- * ex. [exam1, exam2, exam3, etc.]...
+ * @brief Create the Shared Memory simulation clock that decides how every simulated delay passes
+ * The lease duration is scaled along with the delays, but never drops below LEASE_MIN_MILLISECONDS of real time
  *
- * @param exam_count The number of files within the exams/ directory
- * @return char** The array of exam file names
+ * @param num_ta_processes Number of TAs that need their own virtual clock
+ * @param options Options the marker was started with, for the time scale and clock mode
+ * @return *simulation_clock A pointer to the simulation clock in shared memory
  */
-char **list_exams(int *exam_count);
+simulation_clock *createSharedMemClock(int num_ta_processes, const marker_options *options);
 
 /**
- * @brief Helper function to remove specific element from an array
- * This will be used to remove an already marked question from the array of all question number
+ * @brief Let a simulated delay pass for a TA
+ * In real time the TA sleeps for seconds * time_scale (not at all for a scale of 0),
+ * in virtual time only the TA's own virtual clock moves forward and the TA carries on right away
  *
- * @param arr Array to remove an element from
- * @param size Size of the array
- * @param index Index of the element to remove
- * @return int Returns the size of the new array
+ * @param clock Pointer to the simulation clock in shared memory
+ * @param ta Number of the TA the delay is for
+ * @param seconds Length of the delay at a time scale of 1
  */
-int remove_by_index(int arr[], int size, int index);
+void simulated_delay(simulation_clock *clock, int ta, double seconds);
 
 /**
- * @brief Create a TA Process to run concurrently with other TA proccesses to mark questions on exams
+ * @brief In virtual time, wait until no running TA is behind this TA's virtual clock
+ * This keeps what TAs do in the same order it would happen in real time, so work is handed out the same way
+ * TAs that are idle or finished are parked and never waited for, and after half a lease of real time we stop waiting
+ * so a TA that died can't hold everybody up
  *
- * @param num_ta_processes Number of TA processes to create based on supplied command line args in main()
- * @param rubric Pointer to the rubric in shared memory to grade from
- * @param exam Pointer to the exam in shared memory to grade
- * @param exam_count Number of exams that need to be graded, depends on amount of exam files in exams/
- * @param exam_files Array of all the exam files in exams/
- * @param semaphore_id The ID (int) of the semaphore to be used for accessing critical sections of memory
- * @return pid_t* Return an array containing the pid's of all TA processes
+ * @param clock Pointer to the simulation clock in shared memory
+ * @param ta Number of the TA that wants to carry on
+ */
+void wait_for_virtual_turn(simulation_clock *clock, int ta);
+
+/**
+ * @brief Park a TA's virtual clock while it is idle or once it is done, so no other TA waits for it
+ *
+ * @param clock Pointer to the simulation clock in shared memory
+ * @param ta Number of the TA that is going idle
+ */
+void park_virtual_clock(simulation_clock *clock, int ta);
+
+/**
+ * @brief Bring a parked TA back, its virtual clock jumps ahead to the earliest running TA since it was idle until then
+ *
+ * @param clock Pointer to the simulation clock in shared memory
+ * @param ta Number of the TA that is looking for work again
+ */
+void unpark_virtual_clock(simulation_clock *clock, int ta);
+
+/**
+ * @brief Get the virtual time of the TA that got furthest, i.e., how long the marking would have taken in real time
+ *
+ * @param clock Pointer to the simulation clock in shared memory
+ * @return unsigned long long Largest virtual time of any TA in nanoseconds, 0 when not running in virtual time
+ */
+unsigned long long virtual_makespan_ns(simulation_clock *clock);
+
+/**
+ * @brief Function to actually write the rubric corrections to the hardcopy rubric.txt file in the directory
+ * The rubric is written to RUBRIC_FILE_TMP first, synced to disk and renamed over rubric.txt, so neither a crash nor a power loss
+ * leaves an empty rubric
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return int 0 on success, -1 if rubric.txt could not be written
+ */
+int correct_hardcopy_rubric(rubric_shared_data *rubric);
+
+/**
+ * @brief Write every rubric correction made since the last flush to rubric.txt in one go
+ * The dirty bits are taken all at once, so corrections from any number of TAs are coalesced into a single rewrite,
+ * and nothing is written at all if no entry changed
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return int Number of corrected entries written, 0 if there was nothing to flush, -1 if rubric.txt could not be written
+ */
+int flush_rubric(rubric_shared_data *rubric);
+
+/**
+ * @brief Function to check if a rubric line needs to be correct according to random generated num (1 or 0)
+ * If the rubric line needs to be correct, increment and ASCII character by 1
+ * If the line does not need to be corrected, do nothing to it
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @param ta Number of the TA doing the correction for printing purposes
+ * @param clock Pointer to the simulation clock in shared memory, the review delays pass on it
+ * @param rng The TA's random number generator, decides the review delays and which lines need correcting
+ * @param events The TA's event ring, what the TA does is logged there instead of printed
+ * @param stats The TA's latency histograms, the rubric lock wait and hold times are recorded there
+ * @param shutdown Pointer to the shutdown state in shared memory, the review stops before the next line once the run is shutting down
+ */
+void check_and_correct_rubric(rubric_shared_data *rubric, int ta, simulation_clock *clock, ta_rng *rng, ta_event_ring *events, latency_stats *stats, shutdown_state *shutdown);
+
+/**
+ * @brief Check if the exam question is already marked through its bit in question_status
+ * If the bit is 1, it is already marked
+ * If the bit is 0, it is not yet marked
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_q_to_mark Specific question to check if it is marked
+ * @return int If 1 is returned, question is marked, if 0, not marked
+ */
+int is_exam_q_marked(exam_file_shared_data *exam, int exam_q_to_mark);
+
+/**
+ * @brief Get the current time from the monotonic clock in nanoseconds
+ * CLOCK_MONOTONIC is the same for every process on the machine, so lease deadlines can be compared between TAs
+ *
+ * @return unsigned long long Nanoseconds since an arbitrary fixed point
+ */
+unsigned long long now_nanoseconds();
+
+/**
+ * @brief Lease a question so no other TA marks it at the same time
+ * The lease is taken with a single compare-and-swap of its deadline from 0 to now + lease duration, so a question is
+ * never claimed without a deadline that eventually runs out, even if the TA dies right after claiming it.
+ * If the lease has run out (the owner died or stalled) the question can be taken over by swapping in a new deadline the same way
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_q_to_mark Specific question to claim
+ * @param ta Number of the TA claiming the question
+ * @param lease_duration_ns How long the lease lasts on the monotonic clock, from the simulation clock
+ * @param own_deadline Where to store the deadline we swapped in, the lease is only released while it still holds that deadline
+ * @return int CLAIM_FAILED if another TA holds the question or it is marked, CLAIM_NEW if it was free, CLAIM_RECLAIMED if an expired lease was taken over
+ */
+int claim_question(exam_file_shared_data *exam, int exam_q_to_mark, int ta, unsigned long long lease_duration_ns, unsigned long long *own_deadline);
+
+/**
+ * @brief Now that the question has been leased, we can mark it and commit the mark
+ * i.e., set its bit in question_status from 0 to 1, no lock is needed since the marking delay runs outside any lock
+ * and setting the bit is an atomic fetch_or. If the lease ran out and another TA also marks the question, setting the bit twice is harmless.
+ * The lease is only released if it still holds own_deadline, a lease another TA took over after ours ran out stays theirs
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_index Index of the exam in the exam_files[] array
+ * @param exam_q_to_mark Specific question to mark
+ * @param rubric_version Version of the rubric the question was marked against
+ * @param clock Pointer to the simulation clock in shared memory, the marking delay passes on it
+ * @param shutdown Pointer to the shutdown state in shared memory, the 9999 sentinel requests the shutdown there
+ * @param ta Number of the TA marking the question
+ * @param rng The TA's random number generator, decides the marking delay
+ * @param events The TA's event ring, the logger prints what the TA is doing from there
+ * @param own_deadline The deadline claim_question() swapped in for our lease
+ * @return int 1 if this mark was the last one needed to fully mark the exam, 0 otherwise,
+ * -1 if the exam is the 9999 sentinel and nothing was marked
+ */
+int mark_question(exam_file_shared_data *exam, int exam_index, int exam_q_to_mark, unsigned int rubric_version, simulation_clock *clock, shutdown_state *shutdown, int ta, ta_rng *rng, ta_event_ring *events, unsigned long long own_deadline);
+
+/**
+ * @brief Look through the runnable prefix of the exam table for a question that can be taken over once no exams are left to claim
+ * A question can be taken if it is unmarked and either nobody has claimed it (its task is still in a deque,
+ * or the TA that claimed the exam died before queueing it) or its lease has expired
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param scan_from Index of the first exam that may still be unmarked, exams before it are fully marked and are skipped next time
+ * @param ta Number of the TA looking for work
+ * @param lease_duration_ns How long the lease lasts on the monotonic clock, from the simulation clock
+ * @param task Where to store the question that was claimed
+ * @param own_deadline Where to store the deadline of the lease on the claimed question
+ * @return int 1 if a question was claimed, 0 if none can be claimed yet but some are still leased, -1 if every exam is fully marked
+ */
+int reclaim_question(exam_table_shared_data *table, int *scan_from, int ta, unsigned long long lease_duration_ns, marking_task *task, unsigned long long *own_deadline);
+
+/**
+ * @brief Write the shared memory exam to the actual "harcopy" .txt exam file
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_file_name Name of the exam file to write to, i.e., "exam1", "exam2", etc.
+ * @param question_to_correct The specific exam question that needs to be modified in the harcopy exam file since it's been corrected
+ */
+void correct_hardcopy_exam(exam_file_shared_data *exam, char *exam_file_name, int question_to_correct);
+
+/**
+ * @brief Write the whole exam record to its "hardcopy" .txt exam file
+ * The file is written to a temporary file next to it first, synced to disk and renamed over the exam file, so neither a crash nor a
+ * power loss leaves a half written exam
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_file_name Name of the exam file to write to, i.e., "exam1", "exam2", etc.
+ * @param status The question status word to write, each bit becomes one line of 0 or 1
+ * @return int 0 on success, -1 if the file could not be written
+ */
+int write_exam_file(exam_file_shared_data *exam, const char *exam_file_name, unsigned int status);
+
+/**
+ * @brief Check every exam file guarded by an exam lock stripe after the TA holding the stripe died
+ * The TA may have died half way through rewriting one of them, so any file that doesn't have the fixed exam layout
+ * or whose marks don't match the exam record is written again from the record. Must be called with the stripe locked
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param stripe The exam lock stripe whose exam files are checked
+ * @return int Number of exam files that were written again
+ */
+int repair_exam_stripe(exam_table_shared_data *table, char **exam_files, int stripe);
+
+/**
+ * @brief Read how far into the marking journal the exam files were last brought up to date
+ *
+ * @return off_t Offset in bytes of the first journal record not yet reflected in the exam files, 0 if there is no checkpoint
+ */
+off_t read_journal_checkpoint();
+
+/**
+ * @brief Remember that every journal record before checkpoint_offset is reflected in the exam files
+ * The offset is synced to disk before it replaces the old checkpoint, the exam files it vouches for already are
+ *
+ * @param checkpoint_offset Offset in bytes of the first journal record not yet reflected in the exam files
+ */
+void write_journal_checkpoint(off_t checkpoint_offset);
+
+/**
+ * @brief Bring every exam file up to date with the marks in the shared memory exam table
+ * Only exams whose status changed since they were last written are touched. Every journal record appended before this
+ * call is already in the table (the status bit is set before the record is appended), so afterwards the checkpoint moves
+ * to the journal size we saw at the start
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param journal_fd File descriptor of the marking journal
+ * @return int Number of exam files that were written
+ */
+int checkpoint_exam_files(exam_table_shared_data *table, char **exam_files, int journal_fd);
+
+/**
+ * @brief Empty the marking journal and start it over with a fresh header
+ *
+ * @param journal_fd File descriptor of the marking journal, opened with O_APPEND
+ * @return int 0 on success, -1 if the journal could not be reset
+ */
+int reset_marking_journal(int journal_fd);
+
+/**
+ * @brief Check that the marking journal was written by this build and find where its last whole record ends
+ * A crash can tear the last record in half, everything before it is still good and gets replayed
+ *
+ * @param journal_fd File descriptor of the marking journal
+ * @param records_end Where to store the offset just past the last whole record
+ * @return int 1 if its records can be replayed, 0 if it holds no records, -1 if another version of the marker wrote it
+ */
+int marking_journal_replayable(int journal_fd, off_t *records_end);
+
+/**
+ * @brief Open the append-only marking journal, replaying any records a previous run did not get to write to the exam files
+ * Must be called after load_exam_table() and before any TA is created, the journal holds only its header once this returns
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @return int File descriptor of the journal opened for appending, or -1 on error
+ */
+int open_marking_journal(exam_table_shared_data *table, char **exam_files);
+
+/**
+ * @brief Append one mark to the marking journal
+ * This is a single write() of a fixed size record to a file opened with O_APPEND, so TAs never need a lock
+ * and the cost does not depend on how big the exam file or the journal is
+ *
+ * @param journal_fd File descriptor of the marking journal
+ * @param exam_index Index of the marked exam in the exam_files[] array
+ * @param exam Pointer to the marked exam in shared memory
+ * @param question The question (0 based) that was marked
+ * @param ta Number of the TA who marked it
+ */
+void append_journal_record(int journal_fd, int exam_index, exam_file_shared_data *exam, int question, int ta);
+
+/**
+ * @brief Write every remaining mark to the exam files and empty the marking journal
+ * Only called from main() once every TA has terminated
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param journal_fd File descriptor of the marking journal
+ */
+void close_marking_journal(exam_table_shared_data *table, char **exam_files, int journal_fd);
+
+/**
+ * @brief Check that a mapped exam file has the fixed layout the mmap mode relies on
+ * A 4 digit student number and a newline, then one 0 or 1 and a newline per question (the very last newline may be missing)
+ *
+ * @param map Start of the mapped exam file
+ * @param size Size of the exam file in bytes
+ * @return int 1 if the layout is valid, 0 if not
+ */
+int exam_file_layout_valid(const char *map, size_t size);
+
+/**
+ * @brief Map every exam file into memory so TAs can mark questions with a single byte store
+ * The mappings are MAP_SHARED, so they stay valid in every TA process forked afterwards and the stores go straight to the file
+ *
+ * @param exam_files Array of all the exam files in exams/
+ * @param exam_count Number of exams in the exam_files[] array
+ * @return char** Array with the mapping of every exam file, indexed like exam_files[], or NULL if any file could not be mapped or has the wrong layout
+ */
+char **map_exam_files(char **exam_files, int exam_count);
+
+/**
+ * @brief Mark a question directly in the mapped exam file
+ * Every question has its own byte in the file, so TAs marking different questions of the same exam never need a lock
+ *
+ * @param exam_map Mapping of the exam file from map_exam_files()
+ * @param question The question (0 based) that was marked
+ * @param sync_to_disk If 1, msync() the page holding the byte so the mark is on disk before we return
+ */
+void mark_exam_file_in_place(char *exam_map, int question, int sync_to_disk);
+
+/**
+ * @brief Unmap every exam file mapped by map_exam_files() and free the array
+ *
+ * @param exam_maps Array with the mapping of every exam file, entries that were never mapped are NULL
+ * @param exam_count Number of exams in the array
+ */
+void unmap_exam_files(char **exam_maps, int exam_count);
+
+/**
+ * @brief Size in bytes of an exam store holding exam_count records
+ *
+ * @param exam_count Number of exams in the store
+ * @return size_t Size of the header plus every record
+ */
+size_t exam_store_size(int exam_count);
+
+/**
+ * @brief Pack every exam file in exams/ into the exam store
+ * The store is built in memory and written out with write_exam_store()
+ *
+ * @return int 0 on success, -1 if any exam could not be loaded or the store could not be written
+ */
+int import_exam_store();
+
+/**
+ * @brief Write a whole exam store to EXAM_STORE_TMP with a single write() and rename it over EXAM_STORE
+ *
+ * @param store The exam store, built in memory
+ * @param store_size Size of the store from exam_store_size()
+ * @return int 0 on success, -1 if the store could not be written
+ */
+int write_exam_store(exam_store *store, size_t store_size);
+
+/**
+ * @brief Fill the exam store with a synthetic pile of exams, for benchmarking piles much bigger than exams/
+ * Exams are named exam1, exam2, ... and get student numbers counting up from 1000, skipping 9999
+ * Every exam has QUESTIONS_PER_EXAM questions, the first questions_to_mark start out unmarked and the rest already marked
+ *
+ * @param exam_count Number of exams in the pile
+ * @param questions_to_mark Number of questions the TAs have to mark on every exam, 1 to QUESTIONS_PER_EXAM
+ * @param sentinel_at Index of the exam that gets student number 9999 and stops the run, -1 for none
+ * @return int 0 on success, -1 if the store could not be allocated or written
+ */
+int generate_exam_store(int exam_count, int questions_to_mark, int sentinel_at);
+
+/**
+ * @brief Check that an exam name read from the exam store is safe to build "exams/<name>.txt" from
+ * The name has to end inside its field, must not be empty and must not contain '/' or "..", so a corrupt or crafted
+ * store can neither make us read past the record nor write outside exams/ when it is exported
+ *
+ * @param name The exam_name field of a record
+ * @return int 1 if the name is valid, 0 otherwise
+ */
+int exam_store_name_valid(const char *name);
+
+/**
+ * @brief Map the exam store so it can be read and marked in place
+ * Opening the store is an open(), fstat() and mmap() no matter how many exams it holds
+ *
+ * @param store_size Where to store the size of the mapping, needed to unmap it again
+ * @return exam_store* Pointer to the mapped exam store, or NULL if it is missing, not a valid store or holds an invalid exam name
+ */
+exam_store *map_exam_store(size_t *store_size);
+
+/**
+ * @brief Build the exam_files[] array from the exam store, the names point straight into the mapped records
+ *
+ * @param store Pointer to the mapped exam store
+ * @return char** Array of exam names indexed like store->records[], or NULL if it could not be allocated
+ */
+char **exam_store_names(exam_store *store);
+
+/**
+ * @brief Load every record of the exam store into the shared memory exam table, without touching exams/
+ *
+ * @param table Pointer to the exam table in shared memory, created for store->exam_count exams
+ * @param store Pointer to the mapped exam store, the record for table->exams[i] is store->records[i]
+ */
+void load_exam_table_from_store(exam_table_shared_data *table, exam_store *store);
+
+/**
+ * @brief Mark a question directly in the mapped exam store
+ *
+ * @param record The exam's record in the mapped exam store
+ * @param question The question (0 based) that was marked
+ * @param ta Number of the TA who marked the question
+ * @param rubric_version Version of the rubric the question was marked against
+ */
+void mark_exam_store_record(exam_store_record *record, int question, int ta, unsigned int rubric_version);
+
+/**
+ * @brief Flush the exam store to disk and unmap it
+ *
+ * @param store Pointer to the mapped exam store
+ * @param store_size Size of the mapping from map_exam_store()
+ */
+void unmap_exam_store(exam_store *store, size_t store_size);
+
+/**
+ * @brief Write every record of the exam store back out to exams/ in the text layout load_exam() reads
+ *
+ * @return int 0 on success, -1 if the store could not be read or any exam file could not be written
+ */
+int export_exam_store();
+
+/**
+ * @brief Create the Shared Memory event log with one event ring for every TA
+ *
+ * @param num_ta_processes Number of TAs that need their own ring
+ * @return *event_log A pointer to the event log in shared memory
+ */
+event_log *createSharedMemEventLog(int num_ta_processes);
+
+/**
+ * @brief Push one event onto a TA's event ring, the logger process formats and prints it later
+ * Only the owning TA ever pushes to its ring, so this is a plain store of the record followed by a release store of head,
+ * no lock and no system call. If the logger has fallen a whole ring behind we give it a little time, then drop the event
+ *
+ * @param ring The calling TA's event ring
+ * @param type One of the EVENT_ types
+ * @param ta Number of the TA the event is about
+ * @param exam_index Index of the exam in the exam_files[] array, -1 if the event is not about an exam
+ * @param question The question (0 based) the event is about, -1 if none
+ * @param value Event specific value, see the EVENT_ types
+ * @param detail Second event specific value, see the EVENT_ types
+ */
+void log_event(ta_event_ring *ring, int type, int ta, int exam_index, int question, int value, int detail);
+
+/**
+ * @brief Get the name of an event type, as used in the JSON log
+ *
+ * @param type One of the EVENT_ types
+ * @return const char* Name of the event type
+ */
+const char *event_type_name(int type);
+
+/**
+ * @brief Write one event as text, the same lines TAs used to print themselves
+ *
+ * @param out Where to write the event
+ * @param event The event to write
+ * @param table Pointer to the exam table in shared memory, for student numbers
+ * @param exam_files Array of all the exam files in exams/, for exam names
+ */
+void format_event_text(FILE *out, const event_record *event, exam_table_shared_data *table, char **exam_files);
+
+/**
+ * @brief Write a string as a quoted JSON string, escaping quotes, backslashes and control characters
+ *
+ * @param out Where to write the string
+ * @param text The string to write
+ */
+void write_json_string(FILE *out, const char *text);
+
+/**
+ * @brief Write one event as a single line JSON object
+ *
+ * @param out Where to write the event
+ * @param event The event to write
+ * @param table Pointer to the exam table in shared memory, for student numbers
+ * @param exam_files Array of all the exam files in exams/, for exam names
+ */
+void format_event_json(FILE *out, const event_record *event, exam_table_shared_data *table, char **exam_files);
+
+/**
+ * @brief Format and print every event waiting in a TA's ring, then hand the slots back to the TA
+ *
+ * @param ring The TA's event ring
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param log_format LOG_FORMAT_TEXT or LOG_FORMAT_JSON
+ * @return int Number of events printed
+ */
+int drain_event_ring(ta_event_ring *ring, exam_table_shared_data *table, char **exam_files, int log_format);
+
+/**
+ * @brief Fork the logger process, it prints the events TAs push onto their rings until main() tells it to stop
+ * The logger writes to a fully buffered stdout, so a whole batch of events goes out in one write
+ *
+ * @param events Pointer to the event log in shared memory
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param log_format LOG_FORMAT_TEXT or LOG_FORMAT_JSON
+ * @return pid_t PID of the logger process
+ */
+pid_t create_logger_process(event_log *events, exam_table_shared_data *table, char **exam_files, int log_format);
+
+/**
+ * @brief Create the Shared Memory statistics block with one set of latency histograms for main() and every TA
+ *
+ * @param num_ta_processes Number of TAs that need their own set of histograms
+ * @return *stats_block A pointer to the statistics block in shared memory
+ */
+stats_block *createSharedMemStats(int num_ta_processes);
+
+/**
+ * @brief Find the histogram bucket a latency falls into
+ * Small values get a bucket each, larger ones are grouped by their highest bit and the HISTOGRAM_SUB_BUCKET_BITS bits below it
+ *
+ * @param value_ns Latency in nanoseconds
+ * @return int Index into latency_histogram.buckets[]
+ */
+int histogram_bucket(uint64_t value_ns);
+
+/**
+ * @brief Get the largest latency that falls into a histogram bucket, percentiles are reported as this value
+ *
+ * @param bucket Index into latency_histogram.buckets[]
+ * @return uint64_t Largest latency in nanoseconds that histogram_bucket() maps to this bucket
+ */
+uint64_t histogram_bucket_limit(int bucket);
+
+/**
+ * @brief Record one latency in a histogram of a TA's (or main()'s) statistics
+ * Only the owner of the set ever records into it, so this is a few plain increments with no lock and no atomics
+ *
+ * @param stats The set of histograms belonging to the caller
+ * @param metric Which latency was measured, one of the STAT_ values
+ * @param latency_ns The latency in nanoseconds
+ */
+void record_latency(latency_stats *stats, int metric, unsigned long long latency_ns);
+
+/**
+ * @brief Add the counts of one histogram to another
+ *
+ * @param into Histogram to add to
+ * @param from Histogram to add
+ */
+void merge_histogram(latency_histogram *into, const latency_histogram *from);
+
+/**
+ * @brief Get a percentile of the latencies in a histogram
+ * The answer is the limit of the bucket the percentile falls into, so it is at most 12.5% above the real value and never above the max
+ *
+ * @param histogram Histogram to read
+ * @param percentile Percentile between 0 and 100
+ * @return uint64_t Latency in nanoseconds, 0 if the histogram is empty
+ */
+uint64_t histogram_percentile(const latency_histogram *histogram, double percentile);
+
+/**
+ * @brief Get the printable name of a latency metric
+ *
+ * @param metric One of the STAT_ values
+ * @return const char* Name of the metric
+ */
+const char *stat_metric_name(int metric);
+
+/**
+ * @brief Merge the histograms of main() and every TA into one histogram per metric
+ * Must only be called once every TA has exited, the histograms are read without any synchronization
+ *
+ * @param stats Pointer to the statistics block in shared memory
+ * @param merged Where to store the merged histograms
+ */
+void merge_latency_stats(stats_block *stats, latency_stats *merged);
+
+/**
+ * @brief Print p50, p90, p99 and max of every latency that was recorded at least once, merged over main() and every TA
+ *
+ * @param stats Pointer to the statistics block in shared memory
+ */
+void print_latency_stats(stats_block *stats);
+
+/**
+ * @brief Compare two exam names in natural order, so exam2 comes before exam10
+ * Runs of digits are compared by their value, everything else character by character
+ *
+ * @param a First exam name
+ * @param b Second exam name
+ * @return int Less than 0 if a comes first, 0 if they are the same, more than 0 if b comes first
+ */
+int natural_compare(const char *a, const char *b);
+
+/**
+ * @brief qsort() comparison for an array of exam names, sorts them with natural_compare()
+ *
+ * @param a Pointer to the first exam name in the array
+ * @param b Pointer to the second exam name in the array
+ * @return int Same as natural_compare()
+ */
+int compare_exam_names(const void *a, const void *b);
+
+/**
+ * @brief Get an array of exam file names that are contained in the exams/ directory
+ * ex. [exam1, exam2, exam3, etc.]...
+ *
+ * The idea is that if we want to increase or decrease number of exam files in exams/ dir
+ * We can do so without worrying about breaking the rest of the code
+ *
+ * The directory is read once with getdents64(), a big batch of entries per system call, and only *.txt files are kept.
+ * Every name is appended to one string arena that grows by doubling, at the end the arena is moved up behind the array
+ * of pointers into it, so the array and every name live in a single block that is freed with one free().
+ * Exams come back in natural order, i.e., exam1, exam2, ..., exam10 and not the order the directory happens to store them in
+ *
+ * @param exam_count The number of exam files within the exams/ directory
+ * @return char** The array of exam file names, free it with a single free(), or NULL (and an exam_count of 0) if exams/ could not be read
+ */
+char **list_exams(int *exam_count);
+
+/**
+ * @brief Helper function to remove specific element from an array
+ * This will be used to remove an already marked question from the array of all question number
+ *
+ * @param arr Array to remove an element from
+ * @param size Size of the array
+ * @param index Index of the element to remove
+ * @return int Returns the size of the new array
+ */
+int remove_by_index(int arr[], int size, int index);
+
+/**
+ * @brief Everything one TA does, from correcting the rubric to running out of questions to mark
+ * The TA is either a forked process or a thread of main(), both run exactly this with the same shared memory objects and locks
+ *
+ * @param ta Everything the TA needs, its own TA index and the shared memory objects
+ */
+void run_ta(const ta_context *ta);
+
+/**
+ * @brief Create a TA Process to run concurrently with other TA proccesses to mark questions on exams
+ *
+ * @param ta_template Everything the TAs share, the TA index is filled in for every TA
+ * @return pid_t* Return an array containing the pid's of all TA processes
+ */
+pid_t *create_ta_processes(const ta_context *ta_template);
+
+/**
+ * @brief Create every TA as a thread of main() instead of a process, they share main()'s address space
+ * The TAs run the same run_ta() and use the same shared memory objects and locks as TA processes do
+ *
+ * @param ta_template Everything the TAs share, the TA index is filled in for every TA
+ * @return ta_thread* Array of the TA threads and their contexts, free it once every thread is joined
+ */
+ta_thread *create_ta_threads(const ta_context *ta_template);
+
+/**
+ * @brief Start routine of a TA thread
+ *
+ * @param ta_thread_ptr The TA's entry in the ta_thread array
+ * @return void* Always NULL
+ */
+void *ta_thread_main(void *ta_thread_ptr);
+
+/**
+ * @brief Join every TA thread that has finished since the last call, without waiting for the others
+ *
+ * @param ta_threads Array of the TA threads from create_ta_threads()
+ * @param num_ta_threads Number of TA threads
+ * @return int Number of TA threads that were joined by this call
+ */
+int join_finished_ta_threads(ta_thread *ta_threads, int num_ta_threads);
+
+/**
+ * @brief Read the socket and core of every CPU this process may run on
+ * The ids come from /sys/devices/system/cpu/cpu<n>/topology, a CPU without them is put on socket 0 as a core of its own
+ *
+ * @param slots Where to store one slot per CPU, room for CPU_SETSIZE
+ * @return int Number of CPUs found
+ */
+int read_cpu_topology(cpu_slot *slots);
+
+/**
+ * @brief Read one topology id of a CPU from sysfs
+ *
+ * @param cpu The CPU number
+ * @param id_name physical_package_id or core_id
+ * @param fallback What to return if the id cannot be read
+ * @return int The id, or fallback
+ */
+int cpu_topology_id(int cpu, const char *id_name, int fallback);
+
+/**
+ * @brief qsort() comparison that puts CPUs in compact order, socket by socket and core by core, hyperthreads of a core next to each other
+ *
+ * @param a Pointer to the first cpu_slot
+ * @param b Pointer to the second cpu_slot
+ * @return int Less than 0 if a comes first, more than 0 if b comes first
+ */
+int compare_cpu_slots_compact(const void *a, const void *b);
+
+/**
+ * @brief qsort() comparison that puts CPUs in scatter order, one CPU of every socket in turn,
+ * and every core of a socket before the second hyperthread of any core
+ *
+ * @param a Pointer to the first cpu_slot, spread_rank must be filled in
+ * @param b Pointer to the second cpu_slot, spread_rank must be filled in
+ * @return int Less than 0 if a comes first, more than 0 if b comes first
+ */
+int compare_cpu_slots_scatter(const void *a, const void *b);
+
+/**
+ * @brief Decide which CPU every TA is pinned to, from the --pin= placement policy
+ * compact fills one socket core by core before the next, scatter spreads TAs over every socket and core first,
+ * and a list of CPUs is used as given. When there are more TAs than CPUs the placement wraps around
+ *
+ * @param options The options the marker was started with
+ * @param num_tas Number of TAs
+ * @return int* The CPU of every TA, indexed by TA index, or NULL if TAs are not pinned
+ */
+int *plan_ta_placement(const marker_options *options, int num_tas);
+
+/**
+ * @brief Restrict the calling process, or the calling thread of a threaded TA, to a set of CPUs
+ *
+ * @param cpus The CPUs to allow
+ * @param cpu_count Number of CPUs in cpus[]
+ * @return int 0 on success, -1 if the affinity could not be set
+ */
+int pin_to_cpus(const int *cpus, int cpu_count);
+
+/**
+ * @brief Print which CPU every TA was pinned to and which CPUs it started and finished marking on
+ *
+ * @param stats Pointer to the statistics block in shared memory, every TA recorded its CPUs in its own set
+ */
+void print_ta_placement(stats_block *stats);
+
+/**
+ * @brief Pick which semaphore in the set guards a given exam
+ * Exams are spread over EXAM_LOCK_STRIPES semaphores by their index, so with enough stripes every exam has its own lock
+ *
+ * @param exam_index Index of the exam in the exam_files[] array
+ * @return int The semaphore number (stripe) to lock for that exam
+ */
+int exam_lock_stripe(int exam_index);
+
+/**
+ * @brief Create the Shared Memory exam locks, one lock per stripe with the backend picked by --lock=
+ * With LOCK_BACKEND_SYSV every stripe is a semaphore of one SysV semaphore set, the other backends live entirely in the shared memory object
+ *
+ * @param backend One of the LOCK_BACKEND_ values
+ * @param num_ta_processes Number of TAs that may take the locks, every TA gets an MCS queue node
+ * @param semaphore_key Key of the SysV semaphore set, SEMAOPHORE_KEY for marking or IPC_PRIVATE for a set nobody else can find
+ * @return *exam_lock_set A pointer to the exam locks in shared memory
+ */
+exam_lock_set *createSharedMemExamLocks(int backend, int num_ta_processes, key_t semaphore_key);
+
+/**
+ * @brief Remove the exam locks once nobody uses them anymore, so the next run starts clean
+ *
+ * @param locks Pointer to the exam locks in shared memory
+ */
+void remove_exam_locks(exam_lock_set *locks);
+
+/**
+ * @brief Get the name of a lock backend, as it is given to --lock=
+ *
+ * @param backend One of the LOCK_BACKEND_ values
+ * @return const char* Name of the backend
+ */
+const char *lock_backend_name(int backend);
+
+/**
+ * @brief Sleep in the kernel until the futex word is woken, unless it no longer holds the expected value
+ * The lock lives in a MAP_SHARED object, so this is a shared futex and not FUTEX_PRIVATE_FLAG.
+ * The sleep ends after LOCK_OWNER_CHECK_MILLISECONDS at the latest, so the caller can check whether the holder died
+ *
+ * @param word The futex word
+ * @param expected Value the word must still have for the caller to go to sleep
+ * @return int 1 if nobody woke us before the time ran out, 0 otherwise
+ */
+int futex_wait(atomic_uint *word, unsigned int expected);
+
+/**
+ * @brief Wake processes sleeping on a futex word
+ *
+ * @param word The futex word
+ * @param count Most processes to wake
+ */
+void futex_wake(atomic_uint *word, int count);
+
+/**
+ * @brief Check whether a process is gone, to tell that the TA holding an exam lock died
+ * A TA that died but was not reaped by main() yet still exists, main() reaps it within SUPERVISOR_POLL_MICROSECONDS
+ *
+ * @param pid The process to check
+ * @return int 1 if there is no such process anymore, 0 otherwise
+ */
+int process_is_dead(pid_t pid);
+
+/**
+ * @brief Wait a little while spinning on a lock, after LOCK_SPINS_BEFORE_YIELD tries give the CPU to another process
+ * There can be more TAs than CPUs, and the TA we wait for may be one of the ones that are not running
+ *
+ * @param spins Number of times the caller has spun so far, updated
+ */
+void lock_spin_wait(int *spins);
+
+/**
+ * @brief Lock an exam lock stripe so only one TA can work in its critical section
+ * Which lock is taken depends on the backend the locks were created with:
+ * sysv decrements the stripe's semaphore with semop(), a system call every time,
+ * futex takes the lock with one compare-and-swap and only enters the kernel when it has to sleep,
+ * ticket hands the lock out in the order TAs asked for it,
+ * mcs queues every waiting TA on its own node so each one spins on its own cache line, and
+ * robust is a robust process-shared pthread mutex.
+ * If the TA holding the lock died, sysv, futex and robust hand the lock to the next TA with LOCK_OWNER_DIED so it can
+ * repair what the dead TA was writing. ticket and mcs can't tell, which is why parse_arguments() only allows them with TA threads.
+ * sysv retries when a signal interrupts semop(), any other error is reported and counted in locks->lock_failures
+ *
+ * @param locks Pointer to the exam locks in shared memory
+ * @param stripe The lock stripe within the set to lock
+ * @param ta_index 0 based index of the TA taking the lock, picks its MCS queue node
+ * @return int LOCK_ACQUIRED, LOCK_OWNER_DIED if the TA that held the lock died holding it, or LOCK_FAILED if the lock could not be taken
+ */
+int waitSemaphore(exam_lock_set *locks, int stripe, int ta_index);
+
+/**
+ * @brief Unlock an exam lock stripe so that another TA can go work in the critical section
+ *
+ * @param locks Pointer to the exam locks in shared memory
+ * @param stripe The lock stripe within the set to unlock
+ * @param ta_index 0 based index of the TA giving the lock back, must be the one that took it
+ */
+void signalSemaphore(exam_lock_set *locks, int stripe, int ta_index);
+
+/**
+ * @brief Measure one lock backend with a number of processes all fighting over one lock for LOCK_BENCH_MILLISECONDS
+ * Every process takes the lock, bumps a counter that is not atomic and lets it go again, as fast as it can.
+ * If the lock excludes properly the counter ends up equal to the number of times the lock was taken
+ *
+ * @param backend One of the LOCK_BACKEND_ values
+ * @param num_processes Number of processes taking the lock
+ * @param result Where to store what was measured
+ * @return int 0 on success, -1 if the locks or processes could not be created
+ */
+int run_lock_benchmark_once(int backend, int num_processes, lock_bench_result *result);
+
+/**
+ * @brief Compare the throughput and fairness of every lock backend with 2, 4, 8, ... up to options->lock_bench_max_tas processes
+ *
+ * @param options The options the marker was started with
+ * @return int 0 on success, -1 if any run could not be set up
+ */
+int run_lock_benchmark(const marker_options *options);
+
+/**
+ * @brief Generate a fresh pile of exams and run the marker on it once as a benchmark run, then measure it
+ * The run happens in a child process in its own process group, so the 9999 sentinel only stops that run and not the benchmark.
+ * Everything the run prints is thrown away, what it measured is read back from the exam store and the statistics block once it exits
+ *
+ * @param options The benchmark options, the run marks the exam store with time scale 0 and BENCH_SEED
+ * @param exam_count Number of exams in the pile
+ * @param ta_count Number of TAs in this run
+ * @param result Where to store what the run measured
+ * @return int 0 on success, -1 if the run could not be started or measured
+ */
+int run_benchmark_once(const marker_options *options, int exam_count, int ta_count, bench_result *result);
+
+/**
+ * @brief Print one line of the benchmark report
+ *
+ * @param result What the run measured
+ * @param baseline_seconds How long the same pile took with one TA, for the speedup and parallel efficiency
+ * @param bench_format BENCH_FORMAT_CSV or BENCH_FORMAT_JSON
+ */
+void print_bench_result(const bench_result *result, double baseline_seconds, int bench_format);
+
+/**
+ * @brief Copy a whole file, however large, so it can be renamed back over the original later
+ *
+ * @param from Path of the file to copy
+ * @param to Path of the copy, replaced if it exists
+ * @return int 0 on success, -1 if either file could not be opened, read or written
+ */
+int copy_file(const char *from, const char *to);
+
+/**
+ * @brief Benchmark how marking scales, for every pile size in options->bench_exam_counts run 1 to options->bench_max_tas TAs
+ * Every run gets a freshly generated pile in the exam store and runs with the delays off, so it measures the marker itself.
+ * The one TA run of each pile is the baseline for speedup and parallel efficiency. rubric.txt and exams.bin are put back the way they were afterwards
+ *
+ * @param options The options the marker was started with
+ * @return int 0 on success, -1 if any run could not be set up or measured
  */
-pid_t *create_ta_processes(int num_ta_processes,
-                           rubric_shared_data *rubric,
-                           exam_file_shared_data *exam,
-                           int exam_count,
-                           char **exam_files,
-                           int semaphore_id);
+int run_benchmark(const marker_options *options);
 
 /**
- * @brief Decrement semaphore counter so only one process can work in critical section
+ * @brief Read the command line arguments into the marker options
+ * ./main [number of TAs] [--threads] [--lock=sysv|futex|ticket|mcs|robust] [--pin=compact|scatter|<cpu>,<cpu>...] [--exam-io=journal|rewrite|mmap|store] [--msync] [--checkpoint-ms=<ms>] [--rubric-flush-ms=<ms>] [--time-scale=<factor>] [--virtual-time] [--seed=<n>] [--log-format=text|json]
+ * ./main --import-exams | --export-exams
+ * ./main --generate-exams=<count> [--questions=<n>] [--sentinel-at=<index>]
+ * ./main --lock-bench=<max TAs> [--bench-format=csv|json]
+ * ./main --bench=<max TAs> [--bench-exams=<count>[,<count>...]] [--bench-format=csv|json] [--questions=<n>] [--sentinel-at=<index>]
+ * The number of TAs keeps its old meaning, it defaults to 2 and cannot be less than 2
+ * --lock=ticket and --lock=mcs are refused for marking with TA processes, they would stall on a TA that died holding them
  *
- * @param semaphoreID The ID of the semaphore we want to use
+ * @param argc Argument count from main()
+ * @param argv Argument vector from main()
+ * @param options Where to store the parsed options
+ * @return int 0 on success, -1 if an argument was not understood or the options don't go together
  */
-void waitSemaphore(int semaphoreID);
+int parse_arguments(int argc, char *argv[], marker_options *options);
 
 /**
- * @brief Increment semaphore counter so that another process can go work in the critical section
+ * @brief Mark every exam with options->number_of_tas TAs, this is what the marker does unless it was asked to do something else
+ * Creates the shared memory objects and the semaphore set, forks the logger and the TAs, supervises them until they are all done,
+ * then writes out the last marks and rubric corrections and prints how long it all took
  *
- * @param semaphoreID The ID of the semaphore we want to use
+ * @param options The options the marker was started with
+ * @return int 0 once every exam is marked, 1 if marking could not be set up
  */
-void signalSemaphore(int semaphoreID);
+int run_marking(const marker_options *options);
 
 #endif
\ No newline at end of file
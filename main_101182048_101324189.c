@@ -1,6 +1,9 @@
+#define _GNU_SOURCE // sched_setaffinity() and sched_getcpu() for pinning TAs
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -11,6 +14,13 @@
 #include <sys/wait.h>
 #include <signal.h>
 #include <sys/sem.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <limits.h>
+#include <ctype.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 // purely for styling the printouts
 #define ANSI_COLOR_RED "\x1b[31m"
@@ -57,12 +67,173 @@ rubric_shared_data *createSharedMemRubric()
 
     close(shm_fd);
 
-    printf(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR RUBRIC------------" ANSI_COLOR_RESET "\n");
-    printf("Shared memory object for the rubric has been created!\n");
+    // the rubric lock lives inside the shared memory rubric, so it has to be marked as process-shared
+    // for every TA process to be able to use it, and robust so a TA dying while it holds it doesn't lock everybody out
+    pthread_mutexattr_t lock_attr;
+    pthread_mutexattr_init(&lock_attr);
+    pthread_mutexattr_setpshared(&lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&lock_attr, PTHREAD_MUTEX_ROBUST);
+    if (pthread_mutex_init(&rubric_ptr->rubric_lock, &lock_attr) != 0)
+    {
+        fprintf(stderr, "Failed to initialize the rubric lock!\n");
+        pthread_mutexattr_destroy(&lock_attr);
+        munmap(rubric_ptr, sizeof(rubric_shared_data));
+        return NULL;
+    }
+    pthread_mutexattr_destroy(&lock_attr);
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR RUBRIC------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Shared memory object for the rubric has been created!\n");
 
     return rubric_ptr;
 }
 
+/**
+ * @brief Lock a robust process-shared mutex, noticing if the process holding it died
+ * When the owner of a robust mutex dies the kernel hands it to the next process that locks it, with EOWNERDEAD instead of 0.
+ * The mutex is marked consistent again right away, the caller holds it and has to repair whatever it protects
+ *
+ * @param mutex The robust mutex to lock
+ * @return int LOCK_ACQUIRED, or LOCK_OWNER_DIED if the previous owner died holding it
+ */
+int lock_robust_mutex(pthread_mutex_t *mutex)
+{
+    if (pthread_mutex_lock(mutex) != EOWNERDEAD)
+        return LOCK_ACQUIRED;
+    pthread_mutex_consistent(mutex);
+    return LOCK_OWNER_DIED;
+}
+
+/**
+ * @brief Take the rubric lock, only one TA (or main() flushing the rubric) can hold it
+ * TAs marking exams read the published copies and never take it, so there is no need for it to be a reader-writer lock
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return int LOCK_ACQUIRED, or LOCK_OWNER_DIED if a TA died holding it and the caller has to call repair_rubric()
+ */
+int lockRubric(rubric_shared_data *rubric)
+{
+    return lock_robust_mutex(&rubric->rubric_lock);
+}
+
+/**
+ * @brief Release the rubric lock
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ */
+void unlockRubric(rubric_shared_data *rubric)
+{
+    pthread_mutex_unlock(&rubric->rubric_lock);
+}
+
+/**
+ * @brief Look up the rubric text for a single exercise in the latest published copy of the rubric
+ * This takes no lock and writes nothing to shared memory, if a TA overwrites the copy while we read it we just read again
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @param exam_q_to_mark The question (0 based) we want the rubric entry for
+ * @param rubric_version Where to store the version of the rubric the entry was read from
+ * @return char The rubric text for that exercise, or '?' if the rubric has no such entry
+ */
+char read_rubric_entry(rubric_shared_data *rubric, int exam_q_to_mark, unsigned int *rubric_version)
+{
+    for (;;)
+    {
+        unsigned int version = atomic_load_explicit(&rubric->current_version, memory_order_acquire);
+        rubric_copy *copy = &rubric->copies[version % 2];
+
+        unsigned int sequence = atomic_load_explicit(&copy->sequence, memory_order_acquire);
+        if (sequence & 1u)
+            continue; // a TA is overwriting this copy, current_version is about to move
+
+        char rubric_text = '?';
+        unsigned int copy_version = copy->version;
+        if (exam_q_to_mark >= 0 && exam_q_to_mark < copy->entries_loaded)
+            rubric_text = copy->exam_text[exam_q_to_mark];
+
+        // if the copy was overwritten while we read it, what we read may be torn, so start over
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&copy->sequence, memory_order_relaxed) != sequence)
+            continue;
+
+        *rubric_version = copy_version;
+        return rubric_text;
+    }
+}
+
+/**
+ * @brief Publish the working rubric as a new version that TAs marking exams will read from
+ * The new version is written into the spare copy, so readers of the current version are never disturbed,
+ * then current_version moves to it in a single atomic store. Must be called with the rubric lock held for writing
+ * (or before any TA exists)
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return unsigned int The version that was published
+ */
+unsigned int publish_rubric(rubric_shared_data *rubric)
+{
+    unsigned int next_version = atomic_load_explicit(&rubric->current_version, memory_order_relaxed) + 1;
+    rubric_copy *copy = &rubric->copies[next_version % 2];
+
+    // an odd sequence tells TAs still reading the previous version out of this copy that it is being overwritten
+    atomic_fetch_add_explicit(&copy->sequence, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    copy->version = next_version;
+    copy->entries_loaded = rubric->entries_loaded;
+    memcpy(copy->exam_text, rubric->exam_text, sizeof(copy->exam_text));
+
+    atomic_fetch_add_explicit(&copy->sequence, 1, memory_order_release);
+    atomic_store_explicit(&rubric->current_version, next_version, memory_order_release);
+    return next_version;
+}
+
+/**
+ * @brief Bring the rubric back to a consistent state after a TA died holding the rubric lock
+ * The TA may have died half way through a correction or a publish: a copy left with an odd sequence is made even again,
+ * an entry bumped past the last printable character gets the wrap the TA never did, every entry is marked dirty so the
+ * next flush rewrites all of rubric.txt, and the working rubric is published again. Must be called with the rubric lock held
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @param version Where to store the rubric version that was published
+ * @return int Number of rubric entries that had to be fixed
+ */
+int repair_rubric(rubric_shared_data *rubric, unsigned int *version)
+{
+    // only the spare copy is ever written, readers never look at it until current_version moves to it
+    for (int c = 0; c < 2; c++)
+    {
+        if (atomic_load(&rubric->copies[c].sequence) & 1u)
+            atomic_fetch_add(&rubric->copies[c].sequence, 1);
+    }
+
+    int entries_fixed = 0;
+    for (int i = 0; i < rubric->entries_loaded; i++)
+    {
+        if (rubric->exam_text[i] < 32 || rubric->exam_text[i] > 125)
+        {
+            rubric->exam_text[i] = 32;
+            entries_fixed++;
+        }
+    }
+
+    if (rubric->entries_loaded > 0)
+        atomic_fetch_or(&rubric->dirty_entries, rubric->entries_loaded >= 64 ? ~0ULL : (1ULL << rubric->entries_loaded) - 1);
+    *version = publish_rubric(rubric);
+    return entries_fixed;
+}
+
+/**
+ * @brief Get the latest published rubric version
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return unsigned int The latest published rubric version, starting at 1 once rubric.txt is loaded
+ */
+unsigned int published_rubric_version(rubric_shared_data *rubric)
+{
+    return atomic_load_explicit(&rubric->current_version, memory_order_acquire);
+}
+
 /**
  * @brief Read the contents of rubric.txt into the shared memory rubric
  *
@@ -76,7 +247,7 @@ rubric_shared_data *load_rubric(rubric_shared_data *rubric)
 
     rubric->entries_loaded = 0;
 
-    FILE *fp = fopen("rubric/rubric.txt", "r");
+    FILE *fp = fopen(RUBRIC_FILE, "r");
 
     if (!fp)
     {
@@ -97,69 +268,85 @@ rubric_shared_data *load_rubric(rubric_shared_data *rubric)
     }
 
     rubric->entries_loaded = i;
+    atomic_store(&rubric->dirty_entries, 0); // rubric.txt matches what we just loaded
+    publish_rubric(rubric);                  // TAs read the rubric from version 1 onwards
     fclose(fp);
 
-    printf(ANSI_COLOR_RED "\n------------LOADING RUBRIC.TXT INTO SHARED MEMORY------------" ANSI_COLOR_RESET "\n");
-    printf("Rubric file rubric.txt successfully loaded into shared memory!\n");
+    LOG_INFO(ANSI_COLOR_RED "\n------------LOADING RUBRIC.TXT INTO SHARED MEMORY------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Rubric file rubric.txt successfully loaded into shared memory!\n");
 
     return rubric;
 }
 
 /**
- * @brief Create a Shared Memory Exam object with size sizeof(exam_file_shared_data) struct
+ * @brief Create the Shared Memory Exam table with one exam_file_shared_data record for every exam file
+ * The table is mapped once at startup and indexed the same as the exam_files[] array
  *
- * @param exam_shm_name The name of the shared memory exam we want to create
- * @return *xam_file_shared_data A pointer to the shared memory exam object
+ * @param exam_count Number of exams the table needs to hold
+ * @return *exam_table_shared_data A pointer to the exam table in shared memory
  */
-exam_file_shared_data *createSharedMemExam(char *exam_shm_name)
+exam_table_shared_data *createSharedMemExam(int exam_count)
 {
-    // remove name of the exam if it already exists, no error occurs if not
-    shm_unlink(exam_shm_name);
+    // remove name of the exam table if it already exists, no error occurs if not
+    shm_unlink(SHARED_EXAM);
 
-    // create the shared memory exam
-    int shm_fd = shm_open(exam_shm_name, O_CREAT | O_RDWR, 0666);
+    // create the shared memory exam table
+    int shm_fd = shm_open(SHARED_EXAM, O_CREAT | O_RDWR, 0666);
     if (shm_fd == -1)
     {
-        fprintf(stderr, "Failed to create exam!\n");
+        fprintf(stderr, "Failed to create exam table!\n");
         return NULL;
     }
 
-    // configure the size of the shared memory exam
-    if (ftruncate(shm_fd, sizeof(exam_file_shared_data)) == -1)
+    // configure the size of the shared memory exam table, the header plus one record for every exam file
+    size_t table_size = exam_table_size(exam_count);
+    if (ftruncate(shm_fd, table_size) == -1)
     {
-        fprintf(stderr, "Failed to configure the size of exam!\n");
+        fprintf(stderr, "Failed to configure the size of exam table!\n");
         close(shm_fd);
         return NULL;
     }
 
-    // map the shared memory exam into our memory space
-    exam_file_shared_data *exam_ptr = mmap(0, sizeof(exam_file_shared_data),
-                                           PROT_READ | PROT_WRITE, MAP_SHARED,
-                                           shm_fd, 0);
-    if (exam_ptr == MAP_FAILED)
+    // map the shared memory exam table into our memory space
+    exam_table_shared_data *table_ptr = mmap(0, table_size,
+                                             PROT_READ | PROT_WRITE, MAP_SHARED,
+                                             shm_fd, 0);
+    if (table_ptr == MAP_FAILED)
     {
-        fprintf(stderr, "Failed to map the shared memory exam!\n");
+        fprintf(stderr, "Failed to map the shared memory exam table!\n");
         close(shm_fd);
         return NULL;
     }
 
     close(shm_fd);
+    table_ptr->exam_count = exam_count;
+    table_ptr->runnable_count = exam_count;
 
-    printf(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR EXAMS------------" ANSI_COLOR_RESET "\n");
-    printf("Shared memory object for the exams has been created!\n");
-    return exam_ptr;
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR EXAMS------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Shared memory exam table for %d exams has been created!\n", exam_count);
+    return table_ptr;
 }
 
 /**
- * @brief Read the contents of exam1.txt into the shared memory exam object
+ * @brief Size in bytes of an exam table holding exam_count records
+ *
+ * @param exam_count Number of exams in the table
+ * @return size_t Size of the header plus every record
+ */
+size_t exam_table_size(int exam_count)
+{
+    return sizeof(exam_table_shared_data) + sizeof(exam_file_shared_data) * (size_t)exam_count;
+}
+
+/**
+ * @brief Read the contents of an exam file into its record in the shared memory exam table
  *        (struct holds a single student_number as char, status of each individual question (0 = unmarked, 1 = marked,) and entries_loaded)
  *
- * @param exam A pointer to shared memory exam object we want to load with data
+ * @param exam A pointer to the shared memory exam record we want to load with data
  * @param exam_file_name The name of the exam file we want to load into shared memory from exams/ dir
- * @param ta_num The number of the TA responsible for loading the exam
  * @return *exam_file_shared_data A pointer to the loaded exam in shared memory
  */
-exam_file_shared_data *load_exam(exam_file_shared_data *exam, const char *exam_file_name, int ta_num)
+exam_file_shared_data *load_exam(exam_file_shared_data *exam, const char *exam_file_name)
 {
     if (!exam)
         return NULL;
@@ -168,7 +355,6 @@ exam_file_shared_data *load_exam(exam_file_shared_data *exam, const char *exam_f
 
     // create file path for chosen exam file, i.e., exam4 --> exams/exam4.txt
     char file_path[256];
-
     snprintf(file_path, sizeof(file_path), "exams/%s.txt", exam_file_name);
 
     // open the chosen exam file
@@ -179,18 +365,27 @@ exam_file_shared_data *load_exam(exam_file_shared_data *exam, const char *exam_f
         return NULL;
     }
 
-    int sn, s1, s2, s3, s4, s5;
+    int sn, question_value;
+    unsigned int status_bits = 0;
+    int questions_read = 0;
+
+    // read ALL 6 values (student number + status for 5 questions), a marked question sets its bit in the status word
+    if (fscanf(fp, "%d", &sn) == 1)
+    {
+        while (questions_read < QUESTIONS_PER_EXAM && fscanf(fp, "%d", &question_value) == 1)
+        {
+            if (question_value == 1)
+                status_bits |= 1u << questions_read;
+            questions_read++;
+        }
+    }
 
-    // read ALL 6 values (student number + status for 5 questions)
-    if (fscanf(fp, "%d %d %d %d %d %d",
-               &sn, &s1, &s2, &s3, &s4, &s5) == 6)
+    if (questions_read == QUESTIONS_PER_EXAM)
     {
         exam->student_number = sn;
-        exam->q1_status = s1;
-        exam->q2_status = s2;
-        exam->q3_status = s3;
-        exam->q4_status = s4;
-        exam->q5_status = s5;
+        atomic_store(&exam->question_status, status_bits);
+        atomic_store(&exam->question_claimed, status_bits); // questions already marked on paper can never be claimed again
+        exam->materialized_status = status_bits;            // the exam file already shows these marks
 
         exam->entries_loaded = 1; // we loaded one exam record
     }
@@ -200,11 +395,36 @@ exam_file_shared_data *load_exam(exam_file_shared_data *exam, const char *exam_f
     }
 
     fclose(fp);
-    printf(ANSI_COLOR_RED "\n------------LOADING EXAM FILE INTO SHARED MEMORY------------" ANSI_COLOR_RESET "\n");
-    printf("TA %d loaded exam file: %s successfully into shared memory!\n", ta_num, exam_file_name);
     return exam;
 }
 
+/**
+ * @brief Load every exam file in exams/ into its record in the shared memory exam table
+ * This happens once in main() before any TA is created, so TAs never read exam files themselves
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/, the record for exam_files[i] is table->exams[i]
+ * @param stats main()'s set of latency histograms, every load_exam() is recorded in it
+ * @return int 0 on success, -1 if any exam could not be loaded
+ */
+int load_exam_table(exam_table_shared_data *table, char **exam_files, latency_stats *stats)
+{
+    for (int i = 0; i < table->exam_count; i++)
+    {
+        unsigned long long load_started = now_nanoseconds();
+        if (!load_exam(&table->exams[i], exam_files[i]))
+        {
+            fprintf(stderr, "Failed to load exam %s!\n", exam_files[i]);
+            return -1;
+        }
+        record_latency(stats, STAT_LOAD_EXAM, now_nanoseconds() - load_started);
+    }
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------LOADING EXAM FILES INTO SHARED MEMORY------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("All %d exam files loaded successfully into the shared memory exam table!\n", table->exam_count);
+    return 0;
+}
+
 /**
  * @brief Access the rubric in shared memory
  *
@@ -235,617 +455,4133 @@ rubric_shared_data *accessSharedMemRubric()
 }
 
 /**
- * @brief Access the exam stored in shared memory
+ * @brief Access the exam table stored in shared memory
  *
- * @return *exam_file_shared_data A pointer to the exam in shared memory
+ * @return *exam_table_shared_data A pointer to the exam table in shared memory
  */
-exam_file_shared_data *accessSharedMemExam(char *exam_shm_name)
+exam_table_shared_data *accessSharedMemExam()
 {
-    // open the shared memory exam created in main
-    int shm_fd = shm_open(exam_shm_name, O_RDWR, 0666);
+    // open the shared memory exam table created in main
+    int shm_fd = shm_open(SHARED_EXAM, O_RDWR, 0666);
     if (shm_fd == -1)
     {
-        fprintf(stderr, "Failed to open shared memory exam %s...\n", exam_shm_name);
-        return (exam_file_shared_data *)-1; // return error code
+        fprintf(stderr, "Failed to open shared memory exam table %s...\n", SHARED_EXAM);
+        return (exam_table_shared_data *)-1; // return error code
     }
 
-    // map the shared memory exam into our memory space
-    exam_file_shared_data *exam = (exam_file_shared_data *)mmap(0, sizeof(exam_file_shared_data), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (exam == MAP_FAILED)
+    // the size of the table depends on how many exams main() found, so ask the object itself
+    struct stat table_stat;
+    if (fstat(shm_fd, &table_stat) == -1)
     {
-        fprintf(stderr, "Failed to map the shared memory exam %s...\n", exam_shm_name);
+        fprintf(stderr, "Failed to get the size of shared memory exam table %s...\n", SHARED_EXAM);
         close(shm_fd);
-        return (exam_file_shared_data *)-1; // return error code
+        return (exam_table_shared_data *)-1; // return error code
+    }
+
+    // map the shared memory exam table into our memory space
+    exam_table_shared_data *table = (exam_table_shared_data *)mmap(0, table_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (table == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the shared memory exam table %s...\n", SHARED_EXAM);
+        close(shm_fd);
+        return (exam_table_shared_data *)-1; // return error code
     }
 
     close(shm_fd);
-    // return pointer to exam
-    printf(ANSI_COLOR_RED "\n------------ACCESSING EXAM FROM SHARED MEMORY------------" ANSI_COLOR_RESET "\n");
-    printf("%s successfully accessed from shared memory!\n", exam_shm_name);
-    return exam;
+    // return pointer to exam table
+    LOG_VERBOSE(ANSI_COLOR_RED "\n------------ACCESSING EXAM TABLE FROM SHARED MEMORY------------" ANSI_COLOR_RESET "\n");
+    LOG_VERBOSE("Exam table with %d exams successfully accessed from shared memory!\n", table->exam_count);
+    return table;
 }
 
 /**
- * @brief Determine if the exam is fully marked
- * It is fully marked is all question status's i.e., q1_status, q2_status, etc, have a value of 1
+ * @brief Create the Shared Memory Work Queue object, sized to hold one slot for every exam
  *
- * @param exam The exam in shared memory we want to check
- * @param exam_shm_name The name of the exam in shared memory (purely for printing purposes)
- * @return int Status if fully marked or not
+ * @param exam_count Number of exams the queue needs to hold
+ * @return *exam_work_queue A pointer to the work queue in shared memory
  */
-int exam_fully_marked(exam_file_shared_data *exam, char *exam_shm_name)
+exam_work_queue *createSharedMemWorkQueue(int exam_count)
 {
-    if (exam->q1_status == 1 &&
-        exam->q2_status == 1 &&
-        exam->q3_status == 1 &&
-        exam->q4_status == 1 &&
-        exam->q5_status == 1)
+    // remove name of the work queue if it already exists, no error occurs if not
+    shm_unlink(SHARED_WORK_QUEUE);
+
+    // create the shared memory work queue
+    int shm_fd = shm_open(SHARED_WORK_QUEUE, O_CREAT | O_RDWR, 0666);
+    if (shm_fd == -1)
     {
-        printf("Exam %s for student %04d is fully marked!\n", exam_shm_name, exam->student_number);
-        return 1;
+        fprintf(stderr, "Failed to create work queue!\n");
+        return NULL;
     }
-    else
+
+    // configure the size of the shared memory work queue, the header plus one slot per exam
+    size_t queue_size = sizeof(exam_work_queue) + sizeof(int) * exam_count;
+    if (ftruncate(shm_fd, queue_size) == -1)
     {
-        return 0;
+        fprintf(stderr, "Failed to configure the size of work queue!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    // map the shared memory work queue into our memory space
+    exam_work_queue *queue_ptr = mmap(0, queue_size,
+                                      PROT_READ | PROT_WRITE, MAP_SHARED,
+                                      shm_fd, 0);
+    if (queue_ptr == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the shared memory work queue!\n");
+        close(shm_fd);
+        return NULL;
     }
+
+    close(shm_fd);
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR WORK QUEUE------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Shared memory object for the work queue has been created!\n");
+    return queue_ptr;
 }
 
 /**
- * @brief Helper function to generate a random delay value from 0.5 to 1.0 seconds
+ * @brief Index the student number of every exam, in the order exams are handed out, to find where the 9999 sentinel cuts the pile off
+ * Every exam before the first sentinel is the runnable prefix, it is stored in the exam table and is all TAs are ever
+ * given work from, so no TA marks an exam the sentinel cuts off no matter how the TAs happen to be scheduled.
+ * Must be called after the exam table is loaded and before any TA is created
  *
- * @return double Randomly generated delay value from 0.5 to 1.0 seconds
+ * @param table Pointer to the exam table in shared memory
+ * @return int Index of the sentinel exam in the exam_files[] array, -1 if no exam has student number 9999
  */
-double random_delay_value()
+int find_runnable_prefix(exam_table_shared_data *table)
 {
-    srand(time(NULL)); // seed rand()
-    double delay_value = 0.5 + ((double)rand() / (double)RAND_MAX) * 0.5;
-    return round(delay_value * 10.0) / 10.0;
+    // exams are handed out in index order, see seed_exam_work_queue()
+    for (int i = 0; i < table->exam_count; i++)
+    {
+        if (table->exams[i].student_number == 9999)
+        {
+            table->runnable_count = i;
+            return i;
+        }
+    }
+
+    table->runnable_count = table->exam_count;
+    return -1;
 }
 
 /**
- * @brief Helper function to generate a random delay value from 1.0 to 2.0 seconds
- * To simulate the amount of time it takes to correct a question
+ * @brief Fill the work queue with every exam from list_exams(), in the order they should be handed out
+ * Must be called before any TA is created
  *
- * @return double Randomly generated delay value from 1.0 to 2.0 seconds
+ * @param queue Pointer to the work queue in shared memory
+ * @param exam_count Number of exams to hand out, the runnable prefix of the exam_files[] array
  */
-double random_correcting_delay()
+void seed_exam_work_queue(exam_work_queue *queue, int exam_count)
 {
-    srand(time(NULL));       // seed rand()
-    int r = rand() % 11;     // generates 0–10
-    return 1.0 + (r / 10.0); // converts to 1.0–2.0 in 0.1 increments
+    for (int i = 0; i < exam_count; i++)
+        queue->exam_order[i] = i;
+
+    queue->exam_count = exam_count;
+    atomic_store(&queue->next_claim, 0);
 }
 
 /**
- * @brief Function to actually write the rubric corrections to the hardcopy rubric.txt file in the directory
+ * @brief Claim the next exam nobody has taken yet
+ * The claim is a single atomic increment of the shared cursor, so every exam is handed to exactly one TA
  *
- * @param rubric Pointer to the rubric in shared memory
+ * @param queue Pointer to the work queue in shared memory
+ * @return int Index of the claimed exam in the exam_files[] array, or -1 once every exam has been claimed
  */
-void correct_hardcopy_rubric(rubric_shared_data *rubric)
+int claim_next_exam(exam_work_queue *queue)
 {
+    int slot = atomic_fetch_add(&queue->next_claim, 1);
+    if (slot >= queue->exam_count)
+        return -1;
 
-    FILE *fp = fopen("rubric/rubric.txt", "w");
+    return queue->exam_order[slot];
+}
 
-    if (!fp)
+/**
+ * @brief Create the Shared Memory Shutdown object, TAs stop taking on work once a TA requests the shutdown in it
+ *
+ * @return *shutdown_state A pointer to the shutdown state in shared memory
+ */
+shutdown_state *createSharedMemShutdown()
+{
+    // remove name of the shutdown state if it already exists, no error occurs if not
+    shm_unlink(SHARED_SHUTDOWN);
+
+    // create the shared memory shutdown state
+    int shm_fd = shm_open(SHARED_SHUTDOWN, O_CREAT | O_RDWR, 0666);
+    if (shm_fd == -1)
     {
-        printf("Could not open rubric.txt file!\n");
-        exit(1);
+        fprintf(stderr, "Failed to create shutdown state!\n");
+        return NULL;
     }
 
-    for (int i = 0; i < rubric->entries_loaded; i++)
+    // configure the size of the shared memory shutdown state, it starts out zero filled so no shutdown is requested
+    if (ftruncate(shm_fd, sizeof(shutdown_state)) == -1)
     {
-        fprintf(fp, "%d,%c\n", rubric->exercise_number[i], rubric->exam_text[i]);
+        fprintf(stderr, "Failed to configure the size of shutdown state!\n");
+        close(shm_fd);
+        return NULL;
     }
 
-    fclose(fp);
+    // map the shared memory shutdown state into our memory space
+    shutdown_state *shutdown_ptr = mmap(0, sizeof(shutdown_state),
+                                        PROT_READ | PROT_WRITE, MAP_SHARED,
+                                        shm_fd, 0);
+    if (shutdown_ptr == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the shared memory shutdown state!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    close(shm_fd);
+    shutdown_ptr->sentinel_exam = -1;
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR SHUTDOWN STATE------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Shared memory object for the shutdown state has been created!\n");
+    return shutdown_ptr;
 }
 
 /**
- * @brief Function to check if a rubric line needs to be correct according to random generated num (1 or 0)
- * If the rubric line needs to be correct, increment and ASCII character by 1
- * If the line does not need to be corrected, do nothing to it
+ * @brief Ask every TA to stop, because the exam with student number 9999 was reached
+ * Only the first request counts, it records who asked, for which exam and when, before the requested flag is raised
  *
- * @param rubric Pointer to the rubric in shared memory
- * @param ta Number of the TA doing the correction for printing purposes
+ * @param shutdown Pointer to the shutdown state in shared memory
+ * @param ta Number of the TA asking
+ * @param exam_index Index of the sentinel exam in the exam_files[] array
+ * @return int 1 if this call requested the shutdown, 0 if it was already requested
  */
-void check_and_correct_rubric(rubric_shared_data *rubric, int ta)
+int request_shutdown(shutdown_state *shutdown, int ta, int exam_index)
 {
-    sleep(1); // sleep a little bit to prevent the printout being laggy
-    printf(ANSI_COLOR_RED "\n------------CORRECTING RUBRIC------------" ANSI_COLOR_RESET "\n");
-    for (int i = 0; i < rubric->entries_loaded; i++)
-    {
-        double delay_val = random_delay_value();
-        // convert deley value in seconds to microseconds for the usleep() function to delay execution
-        int micro = (int)(delay_val * 1000000);
-        usleep(micro);
+    int nobody = 0;
+    if (!atomic_compare_exchange_strong(&shutdown->requested_by, &nobody, ta))
+        return 0;
 
-        // if random value is 1, line in rubric must be corrected
-        if ((rand() % 2) == 1)
-        {
-            rubric->exam_text[i] = rubric->exam_text[i] + 1;
-            printf("TA #%d found rubric value %c incorrect. Correcting to %c!\n", ta, rubric->exam_text[i], rubric->exam_text[i] + 1);
-            // if the original value is the maximum ASCII value, we re-start at the first visible printable character which is "!", or 33
-            if (rubric->exam_text[i] == 126)
-            {
-                printf("TA #%d Reached maximum ASCII Value, resetting to %c whose ASCII value is %d\n", ta, 33, 33);
-                rubric->exam_text[i] = 32;
-            }
-        }
-        else
-        {
-            printf("TA #%d found rubric value %c correct!\n", ta, rubric->exam_text[i]);
-        }
-    }
+    shutdown->requested_ns = now_nanoseconds();
+    shutdown->sentinel_exam = exam_index;
+    atomic_store_explicit(&shutdown->requested, 1, memory_order_release);
+    return 1;
+}
 
-    // writing correct rubric from shared memory back into hardcopy rubric.txt file
-    correct_hardcopy_rubric(rubric);
+/**
+ * @brief Check whether the run is shutting down, TAs call this every time before they take on more work
+ *
+ * @param shutdown Pointer to the shutdown state in shared memory
+ * @return int 1 once a shutdown has been requested, 0 otherwise
+ */
+int shutdown_requested(shutdown_state *shutdown)
+{
+    return atomic_load_explicit(&shutdown->requested, memory_order_acquire);
 }
 
 /**
- * @brief Check if the exam question is already marked through q<x>_status
- * If question status is 1, it is already marked
- * If question status is 0, it is not yet marked
+ * @brief Print where the 9999 sentinel cut the pile off and, if a TA still reached it, how long the run took to stop
+ * Normally the sentinel is found at startup and no TA has to be stopped, the latency only exists when the shutdown flag was set
  *
- * @param exam Pointer to the exam in shared memory
- * @param exam_q_to_mark Specific question to check if it is marked
- * @return int If 1 is returned, question is marked, if 0, not marked
+ * @param shutdown Pointer to the shutdown state in shared memory
+ * @param stats Pointer to the statistics block in shared memory, every TA recorded when it stopped in its own set
+ * @param table Pointer to the exam table in shared memory, for how many exams were cut off
+ * @param exam_files Array of all the exam files in exams/, for the name of the sentinel exam
+ * @param tas_stopped_ns Monotonic clock time main() saw the last TA exit
  */
-int is_exam_q_marked(exam_file_shared_data *exam, int exam_q_to_mark)
+void print_shutdown_latency(shutdown_state *shutdown, stats_block *stats, exam_table_shared_data *table, char **exam_files, unsigned long long tas_stopped_ns)
 {
-    if (exam_q_to_mark == 0 && exam->q1_status == 1)
-    {
-        return 1;
-    }
-    else if (exam_q_to_mark == 1 && exam->q2_status == 1)
-    {
-        return 1;
-    }
-    else if (exam_q_to_mark == 2 && exam->q3_status == 1)
-    {
-        return 1;
-    }
-    else if (exam_q_to_mark == 3 && exam->q4_status == 1)
+    if (shutdown->sentinel_exam == -1)
+        return;
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------SHUTDOWN------------" ANSI_COLOR_RESET "\n");
+    if (!shutdown_requested(shutdown))
     {
-        return 1;
+        LOG_INFO("Student number 9999 was found on exam %s at index %d at startup, the %d exams from it on were cut off and no TA had to be stopped\n",
+                 exam_files[shutdown->sentinel_exam], shutdown->sentinel_exam, table->exam_count - shutdown->sentinel_exam);
+        return;
     }
-    else if (exam_q_to_mark == 4 && exam->q5_status == 1)
+
+    // the last TA to stop taking work is the one that was busy saving a mark, or waiting for a lock, for the longest
+    unsigned long long last_ta_stopped = shutdown->requested_ns;
+    for (int ta = 1; ta <= stats->ta_count; ta++)
     {
-        return 1;
+        if (stats->sets[ta].finished_ns > last_ta_stopped)
+            last_ta_stopped = stats->sets[ta].finished_ns;
     }
-    return 0;
+
+    LOG_INFO("TA %d reached student number 9999 on exam %s, the last TA stopped taking work %.3f ms later and every TA had exited after %.3f ms\n",
+             shutdown->requested_by, exam_files[shutdown->sentinel_exam],
+             (last_ta_stopped - shutdown->requested_ns) / 1e6, (tas_stopped_ns - shutdown->requested_ns) / 1e6);
 }
 
 /**
- * @brief Now that the question status is checked if it is marked, we can mark it
- * i.e., change its status from 0 to 1
+ * @brief Create the Shared Memory Task Deques object, one deque of (exam, question) tasks for every TA
  *
- * @param exam Pointer to the exam in shared memory
- * @param exam_q_to_mark Specific question to mark
+ * @param num_ta_processes Number of TAs, each one owns a deque
+ * @return *ta_task_deque A pointer to the first deque in shared memory
  */
-void mark_question(exam_file_shared_data *exam, int exam_q_to_mark)
+ta_task_deque *createSharedMemTaskDeques(int num_ta_processes)
 {
-    printf(ANSI_COLOR_RED "\n------------MARKING EXAM QUESTION------------" ANSI_COLOR_RESET "\n");
-    // as per assignment specifications, if a file with a student number of 9999 is reached
-    // all execution finishes
-    if (exam->student_number == 9999)
-    {
-        printf(ANSI_COLOR_RED "\n------------STUDENT NUMBER 9999 DETECTED. EXITING PROGRAM NOW.------------" ANSI_COLOR_RESET "\n");
-        kill(0, SIGTERM);
-    }
-
-    double correcting_delay = random_correcting_delay();
-    // convert deley value in seconds to microseconds for the usleep() function to delay execution
-    int micro = (int)(correcting_delay * 1000000);
-    usleep(micro);
+    // remove name of the task deques if they already exist, no error occurs if not
+    shm_unlink(SHARED_TASK_DEQUES);
 
-    if (exam_q_to_mark == 0)
-    {
-        exam->q1_status = 1;
-    }
-    else if (exam_q_to_mark == 1)
+    // create the shared memory task deques
+    int shm_fd = shm_open(SHARED_TASK_DEQUES, O_CREAT | O_RDWR, 0666);
+    if (shm_fd == -1)
     {
-        exam->q2_status = 1;
+        fprintf(stderr, "Failed to create task deques!\n");
+        return NULL;
     }
-    else if (exam_q_to_mark == 2)
+
+    // configure the size of the shared memory task deques
+    size_t deques_size = sizeof(ta_task_deque) * num_ta_processes;
+    if (ftruncate(shm_fd, deques_size) == -1)
     {
-        exam->q3_status = 1;
+        fprintf(stderr, "Failed to configure the size of task deques!\n");
+        close(shm_fd);
+        return NULL;
     }
-    else if (exam_q_to_mark == 3)
+
+    // map the shared memory task deques into our memory space
+    ta_task_deque *deques_ptr = mmap(0, deques_size,
+                                     PROT_READ | PROT_WRITE, MAP_SHARED,
+                                     shm_fd, 0);
+    if (deques_ptr == MAP_FAILED)
     {
-        exam->q4_status = 1;
+        fprintf(stderr, "Failed to map the shared memory task deques!\n");
+        close(shm_fd);
+        return NULL;
     }
-    else if (exam_q_to_mark == 4)
+
+    close(shm_fd);
+
+    // every deque has its own small lock, it is only held for the push/pop/steal itself so it is process-shared and short lived,
+    // and robust so a TA dying in the middle of one doesn't leave the deque locked for good
+    pthread_mutexattr_t lock_attr;
+    pthread_mutexattr_init(&lock_attr);
+    pthread_mutexattr_setpshared(&lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&lock_attr, PTHREAD_MUTEX_ROBUST);
+    for (int i = 0; i < num_ta_processes; i++)
     {
-        exam->q5_status = 1;
+        pthread_mutex_init(&deques_ptr[i].deque_lock, &lock_attr);
+        deques_ptr[i].head = 0;
+        deques_ptr[i].tail = 0;
     }
+    pthread_mutexattr_destroy(&lock_attr);
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR TASK DEQUES------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Shared memory object for the task deques has been created!\n");
+    return deques_ptr;
 }
 
 /**
- * @brief Write the shared memory exam to the actual "harcopy" .txt exam file
+ * @brief Lock a TA's deque, repairing the deque if a TA died holding its lock
+ * head and tail are only ever changed one at a time, so all a dead TA can leave behind is a deque with tail past head
+ * or more tasks than fit. Such a deque is emptied, the tasks it held are still leased and reclaim_question() picks them up
+ * once their lease runs out
  *
- * @param exam Pointer to the exam in shared memory
- * @param exam_file_name Name of the exam file to write to, i.e., "exam1", "exam2", etc.
- * @param question_to_correct The specific exam question that needs to be modified in the harcopy exam file since it's been corrected
+ * @param deque Pointer to the deque to lock
  */
-void correct_hardcopy_exam(exam_file_shared_data *exam, char *exam_file_name, int question_to_correct)
+void lock_task_deque(ta_task_deque *deque)
 {
-    // create the file path with the supplied exam_file_name argument, open the file for reading and writing
-    char file_path[256];
-    snprintf(file_path, sizeof(file_path), "exams/%s.txt", exam_file_name);
+    if (lock_robust_mutex(&deque->deque_lock) == LOCK_ACQUIRED)
+        return;
+    if (deque->head - deque->tail < 0 || deque->head - deque->tail > TASK_DEQUE_CAPACITY)
+        deque->tail = deque->head;
+}
 
-    FILE *fp = fopen(file_path, "r+");
-    if (!fp)
+/**
+ * @brief Push a task onto the head of a TA's own deque
+ *
+ * @param deque Pointer to the deque owned by the calling TA
+ * @param task The (exam, question) task to push
+ * @return int 1 if the task was pushed, 0 if the deque is full
+ */
+int push_task(ta_task_deque *deque, marking_task task)
+{
+    lock_task_deque(deque);
+    if (deque->head - deque->tail == TASK_DEQUE_CAPACITY)
     {
-        printf("Could not open %s.txt file!", exam_file_name);
-        exit(1);
+        pthread_mutex_unlock(&deque->deque_lock);
+        fprintf(stderr, "Task deque is full!\n");
+        return 0;
     }
 
-    // store all six lines from opened exam .txt file for later use
-    char lines[6][64];
+    deque->tasks[deque->head % TASK_DEQUE_CAPACITY] = task;
+    deque->head++;
+    pthread_mutex_unlock(&deque->deque_lock);
+    return 1;
+}
 
-    for (int i = 0; i < 6; i++)
+/**
+ * @brief Pop the most recently pushed task from the head of a TA's own deque
+ *
+ * @param deque Pointer to the deque owned by the calling TA
+ * @param task Where to store the popped task
+ * @return int 1 if a task was popped, 0 if the deque is empty
+ */
+int pop_task(ta_task_deque *deque, marking_task *task)
+{
+    lock_task_deque(deque);
+    if (deque->head == deque->tail)
     {
-        if (fgets(lines[i], sizeof(lines[i]), fp) == NULL)
+        pthread_mutex_unlock(&deque->deque_lock);
+        return 0;
+    }
+
+    deque->head--;
+    *task = deque->tasks[deque->head % TASK_DEQUE_CAPACITY];
+    pthread_mutex_unlock(&deque->deque_lock);
+    return 1;
+}
+
+/**
+ * @brief Steal the oldest task from the tail of another TA's deque
+ * Victims are tried starting from a random TA so thieves don't all pile onto the same deque
+ *
+ * @param deques Pointer to the first deque in shared memory
+ * @param num_ta_processes Number of TAs (and deques)
+ * @param ta_index Index of the TA doing the stealing, its own deque is skipped
+ * @param rng The stealing TA's random number generator, picks the first victim
+ * @param task Where to store the stolen task
+ * @return int 1 if a task was stolen, 0 if every other deque is empty
+ */
+int steal_task(ta_task_deque *deques, int num_ta_processes, int ta_index, ta_rng *rng, marking_task *task)
+{
+    int start = ta_rng_below(rng, num_ta_processes);
+
+    for (int k = 0; k < num_ta_processes; k++)
+    {
+        int victim = (start + k) % num_ta_processes;
+        if (victim == ta_index)
+            continue;
+
+        ta_task_deque *deque = &deques[victim];
+        lock_task_deque(deque);
+        if (deque->head != deque->tail)
         {
-            fclose(fp);
-            return;
+            *task = deque->tasks[deque->tail % TASK_DEQUE_CAPACITY];
+            deque->tail++;
+            pthread_mutex_unlock(&deque->deque_lock);
+            return 1;
         }
+        pthread_mutex_unlock(&deque->deque_lock);
     }
+    return 0;
+}
 
-    int new_value;
+/**
+ * @brief Determine if the exam is fully marked
+ * It is fully marked when every question has its bit set in the status word, so this is a single compare
+ *
+ * @param exam The exam in shared memory we want to check
+ * @return int Status if fully marked or not
+ */
+int exam_fully_marked(exam_file_shared_data *exam)
+{
+    return atomic_load(&exam->question_status) == ALL_QUESTIONS_MASK;
+}
 
-    // select the question we corrected and get's its current status
-    if (question_to_correct == 0)
-        new_value = exam->q1_status;
-    else if (question_to_correct == 1)
-        new_value = exam->q2_status;
-    else if (question_to_correct == 2)
-        new_value = exam->q3_status;
-    else if (question_to_correct == 3)
-        new_value = exam->q4_status;
-    else if (question_to_correct == 4)
-        new_value = exam->q5_status;
+/**
+ * @brief Step a splitmix64 generator, only used to spread a seed over the state of a TA's generator
+ *
+ * @param state The splitmix64 state, moved forward by one step
+ * @return uint64_t The next splitmix64 output
+ */
+uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Seed a TA's random number generator from the run seed and the TA number
+ * The same seed and TA number always give the same sequence, different TAs get unrelated sequences
+ *
+ * @param rng The TA's random number generator
+ * @param seed Seed of the whole run, from --seed
+ * @param ta Number of the TA the generator belongs to
+ */
+void seed_ta_rng(ta_rng *rng, uint64_t seed, int ta)
+{
+    uint64_t state = seed ^ ((uint64_t)ta * 0xd1b54a32d192ed03ULL);
+    for (int i = 0; i < 4; i++)
+        rng->state[i] = splitmix64(&state);
+}
+
+/**
+ * @brief Get the next 64 random bits from a TA's generator (xoshiro256**)
+ *
+ * @param rng The TA's random number generator
+ * @return uint64_t 64 random bits
+ */
+uint64_t ta_rng_next(ta_rng *rng)
+{
+    uint64_t *s = rng->state;
+    uint64_t result = s[1] * 5;
+    result = ((result << 7) | (result >> 57)) * 9;
+
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+
+    return result;
+}
+
+/**
+ * @brief Get a random number from 0 to bound - 1 from a TA's generator
+ *
+ * @param rng The TA's random number generator
+ * @param bound How many different values there can be, must be at least 1
+ * @return int Random number from 0 to bound - 1
+ */
+int ta_rng_below(ta_rng *rng, int bound)
+{
+    // scale the top 32 bits into [0, bound), no division needed
+    return (int)(((ta_rng_next(rng) >> 32) * (uint64_t)bound) >> 32);
+}
+
+/**
+ * @brief Get a random number from 0.0 up to (not including) 1.0 from a TA's generator
+ *
+ * @param rng The TA's random number generator
+ * @return double Random number in [0.0, 1.0)
+ */
+double ta_rng_unit(ta_rng *rng)
+{
+    return (double)(ta_rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Helper function to generate a random delay value from 0.5 to 1.0 seconds
+ *
+ * @param rng The calling TA's random number generator
+ * @return double Randomly generated delay value from 0.5 to 1.0 seconds
+ */
+double random_delay_value(ta_rng *rng)
+{
+    double delay_value = 0.5 + ta_rng_unit(rng) * 0.5;
+    return round(delay_value * 10.0) / 10.0;
+}
+
+/**
+ * @brief Helper function to generate a random delay value from 1.0 to 2.0 seconds
+ * To simulate the amount of time it takes to correct a question
+ *
+ * @param rng The calling TA's random number generator
+ * @return double Randomly generated delay value from 1.0 to 2.0 seconds
+ */
+double random_correcting_delay(ta_rng *rng)
+{
+    int r = ta_rng_below(rng, 11); // generates 0–10
+    return 1.0 + (r / 10.0); // converts to 1.0–2.0 in 0.1 increments
+}
+
+/**
+ * @brief Create the Shared Memory simulation clock that decides how every simulated delay passes
+ * The lease duration is scaled along with the delays, but never drops below LEASE_MIN_MILLISECONDS of real time
+ *
+ * @param num_ta_processes Number of TAs that need their own virtual clock
+ * @param options Options the marker was started with, for the time scale and clock mode
+ * @return *simulation_clock A pointer to the simulation clock in shared memory
+ */
+simulation_clock *createSharedMemClock(int num_ta_processes, const marker_options *options)
+{
+    // remove name of the simulation clock if it already exists, no error occurs if not
+    shm_unlink(SHARED_CLOCK);
+
+    // create the shared memory simulation clock
+    int shm_fd = shm_open(SHARED_CLOCK, O_CREAT | O_RDWR, 0666);
+    if (shm_fd == -1)
+    {
+        fprintf(stderr, "Failed to create simulation clock!\n");
+        return NULL;
+    }
+
+    // configure the size of the shared memory simulation clock, one virtual clock per TA
+    size_t clock_size = sizeof(simulation_clock) + sizeof(atomic_ullong) * (size_t)num_ta_processes;
+    if (ftruncate(shm_fd, clock_size) == -1)
+    {
+        fprintf(stderr, "Failed to configure the size of simulation clock!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    // map the shared memory simulation clock into our memory space
+    simulation_clock *clock_ptr = mmap(0, clock_size,
+                                       PROT_READ | PROT_WRITE, MAP_SHARED,
+                                       shm_fd, 0);
+    if (clock_ptr == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the shared memory simulation clock!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    close(shm_fd);
+
+    clock_ptr->clock_mode = options->virtual_time ? CLOCK_MODE_VIRTUAL : CLOCK_MODE_REAL;
+    clock_ptr->time_scale = options->time_scale;
+    clock_ptr->ta_count = num_ta_processes;
+    for (int i = 0; i < num_ta_processes; i++)
+        atomic_init(&clock_ptr->virtual_time_ns[i], 0);
+
+    // in virtual time nothing sleeps, so a lease only has to outlast the real work of marking a question
+    double lease_scale = clock_ptr->clock_mode == CLOCK_MODE_VIRTUAL ? 0.0 : clock_ptr->time_scale;
+    unsigned long long lease_ns = (unsigned long long)(LEASE_DURATION_SECONDS * 1e9 * lease_scale);
+    if (lease_ns < LEASE_MIN_MILLISECONDS * 1000000ULL)
+        lease_ns = LEASE_MIN_MILLISECONDS * 1000000ULL;
+    clock_ptr->lease_duration_ns = lease_ns;
+
+    // idle TAs check for expired leases a few times per lease
+    clock_ptr->lease_poll_microseconds = LEASE_POLL_MICROSECONDS;
+    if (lease_ns / 10000ULL < LEASE_POLL_MICROSECONDS)
+        clock_ptr->lease_poll_microseconds = (useconds_t)(lease_ns / 10000ULL);
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR SIMULATION CLOCK------------" ANSI_COLOR_RESET "\n");
+    if (clock_ptr->clock_mode == CLOCK_MODE_VIRTUAL)
+        LOG_INFO("Simulation clock is running in virtual time, TAs will not sleep!\n");
     else
+        LOG_INFO("Simulation clock is running at time scale %.3f!\n", clock_ptr->time_scale);
+
+    return clock_ptr;
+}
+
+/**
+ * @brief Let a simulated delay pass for a TA
+ * In real time the TA sleeps for seconds * time_scale (not at all for a scale of 0),
+ * in virtual time only the TA's own virtual clock moves forward and the TA carries on as soon as no other TA is behind it
+ *
+ * @param clock Pointer to the simulation clock in shared memory
+ * @param ta Number of the TA the delay is for
+ * @param seconds Length of the delay at a time scale of 1
+ */
+void simulated_delay(simulation_clock *clock, int ta, double seconds)
+{
+    if (clock->clock_mode == CLOCK_MODE_VIRTUAL)
     {
-        fclose(fp);
+        // only this TA ever moves its own clock, so nobody else is updating it at the same time
+        atomic_fetch_add_explicit(&clock->virtual_time_ns[ta - 1], (unsigned long long)(seconds * 1e9), memory_order_relaxed);
+        wait_for_virtual_turn(clock, ta);
         return;
     }
 
-    // update the previously stored six lines with the new line based off the previous if...else if...else block
-    snprintf(lines[question_to_correct + 1], sizeof(lines[0]), "%d\n", new_value);
+    // convert delay value in seconds to microseconds for the usleep() function to delay execution
+    useconds_t micro = (useconds_t)(seconds * clock->time_scale * 1000000);
+    if (micro > 0)
+        usleep(micro);
+}
 
-    fseek(fp, 0, SEEK_SET); // rewind the file to the start to begin printing new lines down below
+/**
+ * @brief In virtual time, wait until no running TA is behind this TA's virtual clock
+ * This keeps what TAs do in the same order it would happen in real time, so work is handed out the same way
+ * TAs that are idle or finished are parked and never waited for, and after half a lease of real time we stop waiting
+ * so a TA that died can't hold everybody up
+ *
+ * @param clock Pointer to the simulation clock in shared memory
+ * @param ta Number of the TA that wants to carry on
+ */
+void wait_for_virtual_turn(simulation_clock *clock, int ta)
+{
+    unsigned long long own_time = atomic_load(&clock->virtual_time_ns[ta - 1]) & ~VIRTUAL_CLOCK_PARKED;
+    unsigned long long give_up = now_nanoseconds() + clock->lease_duration_ns / 2;
 
-    // rewrite the specific exam .txt file from the stored content in lines[][], which is updated with the new content
-    for (int i = 0; i < 6; i++)
-        fputs(lines[i], fp);
+    for (;;)
+    {
+        int behind = 0;
+        for (int i = 0; i < clock->ta_count && !behind; i++)
+        {
+            if (i == ta - 1)
+                continue;
+            unsigned long long other_time = atomic_load(&clock->virtual_time_ns[i]);
+            if (other_time & VIRTUAL_CLOCK_PARKED)
+                continue;
+            // ties go to the lower TA number so two TAs never wait for each other
+            behind = other_time < own_time || (other_time == own_time && i < ta - 1);
+        }
 
-    // flush and truncate the file to only what we need based of final file position
-    long pos = ftell(fp);
-    if (pos != -1)
+        if (!behind || now_nanoseconds() >= give_up)
+            return;
+        sched_yield();
+    }
+}
+
+/**
+ * @brief Park a TA's virtual clock while it is idle or once it is done, so no other TA waits for it
+ *
+ * @param clock Pointer to the simulation clock in shared memory
+ * @param ta Number of the TA that is going idle
+ */
+void park_virtual_clock(simulation_clock *clock, int ta)
+{
+    if (clock->clock_mode == CLOCK_MODE_VIRTUAL)
+        atomic_fetch_or(&clock->virtual_time_ns[ta - 1], VIRTUAL_CLOCK_PARKED);
+}
+
+/**
+ * @brief Bring a parked TA back, its virtual clock jumps ahead to the earliest running TA since it was idle until then
+ *
+ * @param clock Pointer to the simulation clock in shared memory
+ * @param ta Number of the TA that is looking for work again
+ */
+void unpark_virtual_clock(simulation_clock *clock, int ta)
+{
+    if (clock->clock_mode != CLOCK_MODE_VIRTUAL)
+        return;
+
+    unsigned long long own_time = atomic_load(&clock->virtual_time_ns[ta - 1]) & ~VIRTUAL_CLOCK_PARKED;
+    unsigned long long earliest = ~0ULL;
+    for (int i = 0; i < clock->ta_count; i++)
     {
-        fflush(fp);
-        if (ftruncate(fileno(fp), pos) == -1)
-            printf("ftruncate failed\n");
+        unsigned long long other_time = atomic_load(&clock->virtual_time_ns[i]);
+        if (i != ta - 1 && !(other_time & VIRTUAL_CLOCK_PARKED) && other_time < earliest)
+            earliest = other_time;
     }
 
-    fclose(fp);
+    if (earliest != ~0ULL && earliest > own_time)
+        own_time = earliest;
+    atomic_store(&clock->virtual_time_ns[ta - 1], own_time);
+}
+
+/**
+ * @brief Get the virtual time of the TA that got furthest, i.e., how long the marking would have taken in real time
+ *
+ * @param clock Pointer to the simulation clock in shared memory
+ * @return unsigned long long Largest virtual time of any TA in nanoseconds, 0 when not running in virtual time
+ */
+unsigned long long virtual_makespan_ns(simulation_clock *clock)
+{
+    unsigned long long makespan = 0;
+    for (int i = 0; i < clock->ta_count; i++)
+    {
+        unsigned long long ta_time = atomic_load_explicit(&clock->virtual_time_ns[i], memory_order_relaxed) & ~VIRTUAL_CLOCK_PARKED;
+        if (ta_time > makespan)
+            makespan = ta_time;
+    }
+    return makespan;
+}
+
+/**
+ * @brief Function to actually write the rubric corrections to the hardcopy rubric.txt file in the directory
+ * The rubric is written to RUBRIC_FILE_TMP first, synced to disk and renamed over rubric.txt, so neither a crash nor a power loss
+ * leaves an empty rubric
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return int 0 on success, -1 if rubric.txt could not be written
+ */
+int correct_hardcopy_rubric(rubric_shared_data *rubric)
+{
+
+    FILE *fp = fopen(RUBRIC_FILE_TMP, "w");
+
+    if (!fp)
+    {
+        printf("Could not open %s file!\n", RUBRIC_FILE_TMP);
+        return -1;
+    }
+
+    for (int i = 0; i < rubric->entries_loaded; i++)
+    {
+        fprintf(fp, "%d,%c\n", rubric->exercise_number[i], rubric->exam_text[i]);
+    }
+
+    int synced = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    if (fclose(fp) != 0 || !synced || rename(RUBRIC_FILE_TMP, RUBRIC_FILE) == -1)
+    {
+        printf("Could not write rubric.txt file!\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write every rubric correction made since the last flush to rubric.txt in one go
+ * The dirty bits are taken all at once, so corrections from any number of TAs are coalesced into a single rewrite,
+ * and nothing is written at all if no entry changed
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @return int Number of corrected entries written, 0 if there was nothing to flush, -1 if rubric.txt could not be written
+ */
+int flush_rubric(rubric_shared_data *rubric)
+{
+    unsigned long long dirty_entries = atomic_exchange(&rubric->dirty_entries, 0);
+    if (dirty_entries == 0)
+        return 0;
+
+    // the lock keeps TAs from correcting entries while we copy them out
+    if (lockRubric(rubric) == LOCK_OWNER_DIED)
+    {
+        unsigned int version;
+        int entries_fixed = repair_rubric(rubric, &version);
+        dirty_entries |= atomic_exchange(&rubric->dirty_entries, 0);
+        LOG_INFO("A TA died holding the rubric lock, %d rubric entries repaired and version %u published!\n", entries_fixed, version);
+    }
+    int written = correct_hardcopy_rubric(rubric);
+    unlockRubric(rubric);
+
+    if (written == -1)
+    {
+        // put the bits back so the next flush tries again
+        atomic_fetch_or(&rubric->dirty_entries, dirty_entries);
+        return -1;
+    }
+
+    int entries_flushed = __builtin_popcountll(dirty_entries);
+    LOG_INFO(ANSI_COLOR_RED "\n------------FLUSHING RUBRIC CORRECTIONS TO RUBRIC.TXT------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("%d corrected rubric entries written to rubric.txt!\n", entries_flushed);
+    return entries_flushed;
+}
+
+/**
+ * @brief Function to check if a rubric line needs to be correct according to random generated num (1 or 0)
+ * If the rubric line needs to be correct, increment and ASCII character by 1
+ * If the line does not need to be corrected, do nothing to it
+ *
+ * @param rubric Pointer to the rubric in shared memory
+ * @param ta Number of the TA doing the correction for printing purposes
+ * @param clock Pointer to the simulation clock in shared memory, the review delays pass on it
+ * @param rng The TA's random number generator, decides the review delays and which lines need correcting
+ * @param events The TA's event ring, what the TA does is logged there instead of printed
+ * @param stats The TA's latency histograms, the rubric lock wait and hold times are recorded there
+ * @param shutdown Pointer to the shutdown state in shared memory, the review stops before the next line once the run is shutting down
+ */
+void check_and_correct_rubric(rubric_shared_data *rubric, int ta, simulation_clock *clock, ta_rng *rng, ta_event_ring *events, latency_stats *stats, shutdown_state *shutdown)
+{
+    simulated_delay(clock, ta, 1.0); // sleep a little bit to prevent the printout being laggy
+    LOG_EVENT(events, EVENT_RUBRIC_REVIEW, ta, -1, -1, 0, 0);
+    for (int i = 0; i < rubric->entries_loaded && !shutdown_requested(shutdown); i++)
+    {
+        // reviewing the line is the slow part, it doesn't need the lock since we aren't changing anything yet
+        simulated_delay(clock, ta, random_delay_value(rng));
+
+        // if random value is 1, line in rubric must be corrected
+        if (ta_rng_below(rng, 2) == 1)
+        {
+            // only the correction itself needs the rubric to ourselves
+            // nothing is printed while the lock is held, the events are printed later by the logger process
+            unsigned long long lock_requested = now_nanoseconds();
+            int lock_status = lockRubric(rubric);
+            unsigned long long lock_acquired = now_nanoseconds();
+            record_latency(stats, STAT_RUBRIC_LOCK_WAIT, lock_acquired - lock_requested);
+            LOG_EVENT(events, EVENT_RUBRIC_LOCKED, ta, -1, -1, getpid(), 0);
+            if (lock_status == LOCK_OWNER_DIED)
+            {
+                // the TA that held the lock died, possibly half way through a correction
+                unsigned int version;
+                int entries_fixed = repair_rubric(rubric, &version);
+                LOG_EVENT(events, EVENT_RUBRIC_LOCK_REPAIRED, ta, -1, -1, entries_fixed, (int)version);
+            }
+            char old_text = rubric->exam_text[i];
+            rubric->exam_text[i] = rubric->exam_text[i] + 1;
+            atomic_fetch_or(&rubric->dirty_entries, 1ULL << i); // main() writes it to rubric.txt at the next flush
+            LOG_EVENT(events, EVENT_RUBRIC_FIXED, ta, -1, -1, old_text, rubric->exam_text[i]);
+            // if the original value is the maximum ASCII value, we re-start at the first visible printable character which is "!", or 33
+            if (rubric->exam_text[i] == 126)
+            {
+                LOG_EVENT(events, EVENT_RUBRIC_WRAPPED, ta, -1, -1, 0, 0);
+                rubric->exam_text[i] = 32;
+            }
+            // TAs marking exams pick up the correction from here on, marks made before it keep the old version
+            unsigned int version = publish_rubric(rubric);
+            LOG_EVENT(events, EVENT_RUBRIC_PUBLISHED, ta, -1, -1, (int)version, 0);
+            LOG_EVENT(events, EVENT_RUBRIC_UNLOCKED, ta, -1, -1, getpid(), 0);
+            record_latency(stats, STAT_RUBRIC_LOCK_HOLD, now_nanoseconds() - lock_acquired);
+            unlockRubric(rubric);
+        }
+        else
+        {
+            // exam_text[] is only safe to read under the rubric lock, the published copy is safe to read without it
+            unsigned int version;
+            LOG_EVENT(events, EVENT_RUBRIC_OK, ta, -1, -1, read_rubric_entry(rubric, i, &version), 0);
+        }
+    }
+
+    // corrections are only marked dirty here, main() flushes them to rubric.txt so TAs never rewrite the file themselves
+}
+
+/**
+ * @brief Check if the exam question is already marked through its bit in question_status
+ * If the bit is 1, it is already marked
+ * If the bit is 0, it is not yet marked
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_q_to_mark Specific question to check if it is marked
+ * @return int If 1 is returned, question is marked, if 0, not marked
+ */
+int is_exam_q_marked(exam_file_shared_data *exam, int exam_q_to_mark)
+{
+    return (atomic_load(&exam->question_status) >> exam_q_to_mark) & 1u;
+}
+
+/**
+ * @brief Get the current time from the monotonic clock in nanoseconds
+ * CLOCK_MONOTONIC is the same for every process on the machine, so lease deadlines can be compared between TAs
+ *
+ * @return unsigned long long Nanoseconds since an arbitrary fixed point
+ */
+unsigned long long now_nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+/**
+ * @brief Lease a question so no other TA marks it at the same time
+ * The lease is taken with a single compare-and-swap of its deadline from 0 to now + lease duration, so a question is
+ * never claimed without a deadline that eventually runs out, even if the TA dies right after claiming it.
+ * If the lease has run out (the owner died or stalled) the question can be taken over by swapping in a new deadline the same way
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_q_to_mark Specific question to claim
+ * @param ta Number of the TA claiming the question
+ * @param lease_duration_ns How long the lease lasts on the monotonic clock, from the simulation clock
+ * @param own_deadline Where to store the deadline we swapped in, the lease is only released while it still holds that deadline
+ * @return int CLAIM_FAILED if another TA holds the question or it is marked, CLAIM_NEW if it was free, CLAIM_RECLAIMED if an expired lease was taken over
+ */
+int claim_question(exam_file_shared_data *exam, int exam_q_to_mark, int ta, unsigned long long lease_duration_ns, unsigned long long *own_deadline)
+{
+    unsigned int question_bit = 1u << exam_q_to_mark;
+    unsigned long long now = now_nanoseconds();
+    unsigned long long new_deadline = now + lease_duration_ns;
+
+    if (is_exam_q_marked(exam, exam_q_to_mark))
+        return CLAIM_FAILED;
+
+    // a deadline of 0 means nobody holds a lease on the question
+    unsigned long long deadline = atomic_load(&exam->lease_deadline[exam_q_to_mark]);
+    if (deadline != 0 && now < deadline)
+        return CLAIM_FAILED;
+
+    if (!atomic_compare_exchange_strong(&exam->lease_deadline[exam_q_to_mark], &deadline, new_deadline))
+        return CLAIM_FAILED; // another TA leased it first
+
+    // the question may have been marked, and its lease released, right before we swapped in our deadline
+    if (is_exam_q_marked(exam, exam_q_to_mark))
+    {
+        unsigned long long expected = new_deadline;
+        atomic_compare_exchange_strong(&exam->lease_deadline[exam_q_to_mark], &expected, 0);
+        return CLAIM_FAILED;
+    }
+    *own_deadline = new_deadline;
+
+    // the claimed bit only records that the question was handed out at some point, the deadline is what holds the lease
+    unsigned int previous = atomic_fetch_or(&exam->question_claimed, question_bit);
+    if (deadline == 0 && (previous & question_bit) == 0)
+    {
+        exam->lease_owner[exam_q_to_mark] = ta;
+        return CLAIM_NEW;
+    }
+
+    exam->lease_owner[exam_q_to_mark] = ta;
+    return CLAIM_RECLAIMED;
+}
+
+/**
+ * @brief Now that the question has been leased, we can mark it and commit the mark
+ * i.e., set its bit in question_status from 0 to 1, no lock is needed since the marking delay runs outside any lock
+ * and setting the bit is an atomic fetch_or. If the lease ran out and another TA also marks the question, setting the bit twice is harmless.
+ * The lease is only released if it still holds own_deadline, a lease another TA took over after ours ran out stays theirs
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_index Index of the exam in the exam_files[] array
+ * @param exam_q_to_mark Specific question to mark
+ * @param rubric_version Version of the rubric the question was marked against
+ * @param clock Pointer to the simulation clock in shared memory, the marking delay passes on it
+ * @param shutdown Pointer to the shutdown state in shared memory, the 9999 sentinel requests the shutdown there
+ * @param ta Number of the TA marking the question
+ * @param rng The TA's random number generator, decides the marking delay
+ * @param events The TA's event ring, the logger prints what the TA is doing from there
+ * @param own_deadline The deadline claim_question() swapped in for our lease
+ * @return int 1 if this mark was the last one needed to fully mark the exam, 0 otherwise,
+ * -1 if the exam is the 9999 sentinel and nothing was marked
+ */
+int mark_question(exam_file_shared_data *exam, int exam_index, int exam_q_to_mark, unsigned int rubric_version, simulation_clock *clock, shutdown_state *shutdown, int ta, ta_rng *rng, ta_event_ring *events, unsigned long long own_deadline)
+{
+    LOG_EVENT(events, EVENT_QUESTION_STARTED, ta, exam_index, exam_q_to_mark, 0, 0);
+    // as per assignment specifications, if a file with a student number of 9999 is reached
+    // all marking finishes. main() already leaves the sentinel and every exam after it out of the work, so this
+    // is only a backstop: TAs stop taking on work, marks already under way are still saved and main() writes out
+    // everything that is buffered, so nothing is cut off half way like a signal would
+    if (exam->student_number == 9999)
+    {
+        if (request_shutdown(shutdown, ta, exam_index))
+            LOG_EVENT(events, EVENT_SHUTDOWN_REQUESTED, ta, exam_index, -1, 0, 0);
+        return -1;
+    }
+
+    simulated_delay(clock, ta, random_correcting_delay(rng));
+
+    // commit the mark, then release the lease
+    exam->rubric_version[exam_q_to_mark] = rubric_version;
+    unsigned int question_bit = 1u << exam_q_to_mark;
+    unsigned int previous = atomic_fetch_or(&exam->question_status, question_bit);
+    atomic_compare_exchange_strong(&exam->lease_deadline[exam_q_to_mark], &own_deadline, 0);
+    return (previous | question_bit) == ALL_QUESTIONS_MASK && previous != ALL_QUESTIONS_MASK;
+}
+
+/**
+ * @brief Look through the runnable prefix of the exam table for a question that can be taken over once no exams are left to claim
+ * A question can be taken if it is unmarked and either nobody has claimed it (its task is still in a deque,
+ * or the TA that claimed the exam died before queueing it) or its lease has expired
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param scan_from Index of the first exam that may still be unmarked, exams before it are fully marked and are skipped next time
+ * @param ta Number of the TA looking for work
+ * @param lease_duration_ns How long the lease lasts on the monotonic clock, from the simulation clock
+ * @param task Where to store the question that was claimed
+ * @param own_deadline Where to store the deadline of the lease on the claimed question
+ * @return int 1 if a question was claimed, 0 if none can be claimed yet but some are still leased, -1 if every exam is fully marked
+ */
+int reclaim_question(exam_table_shared_data *table, int *scan_from, int ta, unsigned long long lease_duration_ns, marking_task *task, unsigned long long *own_deadline)
+{
+    int leases_outstanding = 0;
+
+    for (int j = *scan_from; j < table->runnable_count; j++)
+    {
+        exam_file_shared_data *exam_record = &table->exams[j];
+        unsigned int status = atomic_load(&exam_record->question_status);
+
+        // everything before the first unmarked exam never has to be looked at again
+        if (status == ALL_QUESTIONS_MASK)
+        {
+            if (j == *scan_from)
+                (*scan_from)++;
+            continue;
+        }
+
+        for (int q = 0; q < QUESTIONS_PER_EXAM; q++)
+        {
+            if ((status >> q) & 1u)
+                continue;
+
+            int claim = claim_question(exam_record, q, ta, lease_duration_ns, own_deadline);
+            if (claim != CLAIM_FAILED)
+            {
+                task->exam_index = j;
+                task->question = q;
+                return 1;
+            }
+
+            if (!is_exam_q_marked(exam_record, q))
+                leases_outstanding = 1;
+        }
+    }
+
+    return leases_outstanding ? 0 : -1;
+}
+
+/**
+ * @brief Write the shared memory exam to the actual "harcopy" .txt exam file
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_file_name Name of the exam file to write to, i.e., "exam1", "exam2", etc.
+ * @param question_to_correct The specific exam question that needs to be modified in the harcopy exam file since it's been corrected
+ */
+void correct_hardcopy_exam(exam_file_shared_data *exam, char *exam_file_name, int question_to_correct)
+{
+    // create the file path with the supplied exam_file_name argument, open the file for reading and writing
+    char file_path[256];
+    snprintf(file_path, sizeof(file_path), "exams/%s.txt", exam_file_name);
+
+    FILE *fp = fopen(file_path, "r+");
+    if (!fp)
+    {
+        printf("Could not open %s.txt file!", exam_file_name);
+        exit(1);
+    }
+
+    // store all six lines from opened exam .txt file for later use
+    char lines[6][64];
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (fgets(lines[i], sizeof(lines[i]), fp) == NULL)
+        {
+            fclose(fp);
+            return;
+        }
+    }
+
+    if (question_to_correct < 0 || question_to_correct >= QUESTIONS_PER_EXAM)
+    {
+        fclose(fp);
+        return;
+    }
+
+    // select the question we corrected and get's its current status
+    int new_value = is_exam_q_marked(exam, question_to_correct);
+
+    // update the previously stored six lines with the new line based off the previous if...else if...else block
+    snprintf(lines[question_to_correct + 1], sizeof(lines[0]), "%d\n", new_value);
+
+    fseek(fp, 0, SEEK_SET); // rewind the file to the start to begin printing new lines down below
+
+    // rewrite the specific exam .txt file from the stored content in lines[][], which is updated with the new content
+    for (int i = 0; i < 6; i++)
+        fputs(lines[i], fp);
+
+    // flush and truncate the file to only what we need based of final file position
+    long pos = ftell(fp);
+    if (pos != -1)
+    {
+        fflush(fp);
+        if (ftruncate(fileno(fp), pos) == -1)
+            printf("ftruncate failed\n");
+    }
+
+    fclose(fp);
+}
+
+/**
+ * @brief Write the whole exam record to its "hardcopy" .txt exam file
+ * The file is written to a temporary file next to it first, synced to disk and renamed over the exam file, so neither a crash nor a
+ * power loss leaves a half written exam
+ *
+ * @param exam Pointer to the exam in shared memory
+ * @param exam_file_name Name of the exam file to write to, i.e., "exam1", "exam2", etc.
+ * @param status The question status word to write, each bit becomes one line of 0 or 1
+ * @return int 0 on success, -1 if the file could not be written
+ */
+int write_exam_file(exam_file_shared_data *exam, const char *exam_file_name, unsigned int status)
+{
+    char file_path[256];
+    snprintf(file_path, sizeof(file_path), "exams/%s.txt", exam_file_name);
+    char temp_path[sizeof(file_path) + sizeof(EXAM_FILE_TMP_SUFFIX)];
+    snprintf(temp_path, sizeof(temp_path), "%s" EXAM_FILE_TMP_SUFFIX, file_path);
+
+    FILE *fp = fopen(temp_path, "w");
+    if (!fp)
+    {
+        printf("Could not open %s file!\n", temp_path);
+        return -1;
+    }
+
+    fprintf(fp, "%04d\n", exam->student_number);
+    for (int q = 0; q < QUESTIONS_PER_EXAM; q++)
+        fprintf(fp, "%u\n", (status >> q) & 1u);
+
+    // the new contents must be on disk before the rename, or a power loss can leave an empty exam file after the journal was reset
+    int synced = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    if (fclose(fp) != 0 || !synced || rename(temp_path, file_path) == -1)
+    {
+        printf("Could not write %s.txt file!\n", exam_file_name);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Check every exam file guarded by an exam lock stripe after the TA holding the stripe died
+ * The TA may have died half way through rewriting one of them, so any file that doesn't have the fixed exam layout
+ * or whose marks don't match the exam record is written again from the record. Must be called with the stripe locked
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param stripe The exam lock stripe whose exam files are checked
+ * @return int Number of exam files that were written again
+ */
+int repair_exam_stripe(exam_table_shared_data *table, char **exam_files, int stripe)
+{
+    int exams_rewritten = 0;
+    for (int i = stripe; i < table->exam_count; i += EXAM_LOCK_STRIPES)
+    {
+        exam_file_shared_data *exam_record = &table->exams[i];
+        unsigned int status = atomic_load(&exam_record->question_status);
+
+        char file_path[256];
+        snprintf(file_path, sizeof(file_path), "exams/%s.txt", exam_files[i]);
+
+        char contents[EXAM_FILE_STATUS_OFFSET + 2 * QUESTIONS_PER_EXAM + 1];
+        size_t size = 0;
+        FILE *fp = fopen(file_path, "r");
+        if (fp)
+        {
+            size = fread(contents, 1, sizeof(contents), fp);
+            fclose(fp);
+        }
+
+        // the record can be ahead of the file, if a TA marked a question and is waiting for the stripe to write it
+        int intact = exam_file_layout_valid(contents, size);
+        for (int q = 0; intact && q < QUESTIONS_PER_EXAM; q++)
+            intact = contents[EXAM_FILE_STATUS_OFFSET + 2 * q] - '0' == (int)((status >> q) & 1u);
+
+        if (!intact && write_exam_file(exam_record, exam_files[i], status) == 0)
+            exams_rewritten++;
+    }
+    return exams_rewritten;
+}
+
+/**
+ * @brief Read how far into the marking journal the exam files were last brought up to date
+ *
+ * @return off_t Offset in bytes of the first journal record not yet reflected in the exam files, 0 if there is no checkpoint
+ */
+off_t read_journal_checkpoint()
+{
+    off_t checkpoint_offset = 0;
+
+    FILE *fp = fopen(MARKING_JOURNAL_CHECKPOINT, "r");
+    if (!fp)
+        return 0;
+
+    long long offset;
+    if (fscanf(fp, "%lld", &offset) == 1 && offset > 0)
+        checkpoint_offset = (off_t)offset;
+
+    fclose(fp);
+    return checkpoint_offset;
+}
+
+/**
+ * @brief Remember that every journal record before checkpoint_offset is reflected in the exam files
+ * The offset is synced to disk before it replaces the old checkpoint, the exam files it vouches for already are
+ *
+ * @param checkpoint_offset Offset in bytes of the first journal record not yet reflected in the exam files
+ */
+void write_journal_checkpoint(off_t checkpoint_offset)
+{
+    FILE *fp = fopen(MARKING_JOURNAL_CHECKPOINT ".tmp", "w");
+    if (!fp)
+    {
+        printf("Could not open %s.tmp file!\n", MARKING_JOURNAL_CHECKPOINT);
+        return;
+    }
+
+    fprintf(fp, "%lld\n", (long long)checkpoint_offset);
+    int synced = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    if (fclose(fp) != 0 || !synced || rename(MARKING_JOURNAL_CHECKPOINT ".tmp", MARKING_JOURNAL_CHECKPOINT) == -1)
+        printf("Could not write %s file!\n", MARKING_JOURNAL_CHECKPOINT);
+}
+
+/**
+ * @brief Bring every exam file up to date with the marks in the shared memory exam table
+ * Only exams whose status changed since they were last written are touched. Every journal record appended before this
+ * call is already in the table (the status bit is set before the record is appended), so afterwards the checkpoint moves
+ * to the journal size we saw at the start
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param journal_fd File descriptor of the marking journal
+ * @return int Number of exam files that were written
+ */
+int checkpoint_exam_files(exam_table_shared_data *table, char **exam_files, int journal_fd)
+{
+    struct stat journal_stat;
+    if (fstat(journal_fd, &journal_stat) == -1)
+        return 0;
+
+    int exams_written = 0;
+    for (int i = 0; i < table->exam_count; i++)
+    {
+        exam_file_shared_data *exam_record = &table->exams[i];
+        unsigned int status = atomic_load(&exam_record->question_status);
+        if (status == exam_record->materialized_status)
+            continue;
+
+        if (write_exam_file(exam_record, exam_files[i], status) == 0)
+        {
+            exam_record->materialized_status = status;
+            exams_written++;
+        }
+    }
+
+    write_journal_checkpoint(journal_stat.st_size);
+    return exams_written;
+}
+
+/**
+ * @brief Empty the marking journal and start it over with a fresh header
+ *
+ * @param journal_fd File descriptor of the marking journal, opened with O_APPEND
+ * @return int 0 on success, -1 if the journal could not be reset
+ */
+int reset_marking_journal(int journal_fd)
+{
+    journal_header header = {
+        .magic = MARKING_JOURNAL_MAGIC,
+        .version = MARKING_JOURNAL_VERSION,
+        .record_size = sizeof(journal_record),
+        .reserved = 0,
+    };
+
+    if (ftruncate(journal_fd, 0) == -1 || write(journal_fd, &header, sizeof(header)) != (ssize_t)sizeof(header))
+    {
+        fprintf(stderr, "Failed to reset the marking journal!\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Check that the marking journal was written by this build and find where its last whole record ends
+ * A crash can tear the last record in half, everything before it is still good and gets replayed
+ *
+ * @param journal_fd File descriptor of the marking journal
+ * @param records_end Where to store the offset just past the last whole record
+ * @return int 1 if its records can be replayed, 0 if it holds no records, -1 if another version of the marker wrote it
+ */
+int marking_journal_replayable(int journal_fd, off_t *records_end)
+{
+    *records_end = sizeof(journal_header);
+    struct stat journal_stat;
+    if (fstat(journal_fd, &journal_stat) == -1 || journal_stat.st_size == 0)
+        return 0;
+
+    journal_header expected = {
+        .magic = MARKING_JOURNAL_MAGIC,
+        .version = MARKING_JOURNAL_VERSION,
+        .record_size = sizeof(journal_record),
+        .reserved = 0,
+    };
+    journal_header header;
+    ssize_t header_length = pread(journal_fd, &header, sizeof(header), 0);
+    if (header_length < 0 || memcmp(&header, &expected, header_length) != 0)
+        return -1;
+    if (header_length < (ssize_t)sizeof(header))
+        return 0; // a reset was cut short after the last checkpoint, so there are no records to lose
+
+    *records_end = journal_stat.st_size - (journal_stat.st_size - sizeof(header)) % sizeof(journal_record);
+    return 1;
+}
+
+/**
+ * @brief Open the append-only marking journal, replaying any records a previous run did not get to write to the exam files
+ * Must be called after load_exam_table() and before any TA is created, the journal holds only its header once this returns
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @return int File descriptor of the journal opened for appending, or -1 on error
+ */
+int open_marking_journal(exam_table_shared_data *table, char **exam_files)
+{
+    int journal_fd = open(MARKING_JOURNAL, O_RDWR | O_CREAT | O_APPEND, 0666);
+    if (journal_fd == -1)
+    {
+        fprintf(stderr, "Failed to open the marking journal %s!\n", MARKING_JOURNAL);
+        return -1;
+    }
+
+    off_t records_end;
+    int replayable = marking_journal_replayable(journal_fd, &records_end);
+    if (replayable == -1)
+    {
+        // its marks may still matter to the version that wrote it, move it aside untouched and start a journal of our own
+        close(journal_fd);
+        if (rename(MARKING_JOURNAL, MARKING_JOURNAL_FOREIGN) == -1)
+        {
+            fprintf(stderr, "%s was not written by this version of the marker and could not be moved aside!\n", MARKING_JOURNAL);
+            return -1;
+        }
+        fprintf(stderr, "%s was not written by this version of the marker, it was moved to %s without being replayed!\n",
+                MARKING_JOURNAL, MARKING_JOURNAL_FOREIGN);
+        unlink(MARKING_JOURNAL_CHECKPOINT);
+        journal_fd = open(MARKING_JOURNAL, O_RDWR | O_CREAT | O_APPEND, 0666);
+        if (journal_fd == -1)
+        {
+            fprintf(stderr, "Failed to open the marking journal %s!\n", MARKING_JOURNAL);
+            return -1;
+        }
+    }
+
+    // a crash half way through an append leaves part of a record at the end, only that part is dropped
+    struct stat journal_stat;
+    if (replayable == 1 && fstat(journal_fd, &journal_stat) == 0 && journal_stat.st_size > records_end)
+    {
+        fprintf(stderr, "%s ends in a torn record, its last %lld bytes are dropped!\n",
+                MARKING_JOURNAL, (long long)(journal_stat.st_size - records_end));
+        ftruncate(journal_fd, records_end);
+    }
+
+    // replay every record after the last checkpoint, a record only counts if it still matches the exam it was written for
+    int marks_recovered = 0;
+    off_t offset = read_journal_checkpoint();
+    if (offset < (off_t)sizeof(journal_header) || offset > records_end || (offset - sizeof(journal_header)) % sizeof(journal_record) != 0)
+        offset = sizeof(journal_header);
+    journal_record record;
+    while (replayable == 1 && offset < records_end && pread(journal_fd, &record, sizeof(record), offset) == (ssize_t)sizeof(record))
+    {
+        offset += sizeof(record);
+
+        if (record.exam_index < 0 || record.exam_index >= table->exam_count ||
+            record.question < 0 || record.question >= QUESTIONS_PER_EXAM ||
+            table->exams[record.exam_index].student_number != record.student_number)
+            continue;
+
+        unsigned int question_bit = 1u << record.question;
+        atomic_fetch_or(&table->exams[record.exam_index].question_status, question_bit);
+        atomic_fetch_or(&table->exams[record.exam_index].question_claimed, question_bit);
+        table->exams[record.exam_index].rubric_version[record.question] = record.rubric_version;
+        marks_recovered++;
+    }
+
+    // write the recovered marks into the exam files, then start the journal over
+    checkpoint_exam_files(table, exam_files, journal_fd);
+    reset_marking_journal(journal_fd);
+    unlink(MARKING_JOURNAL_CHECKPOINT);
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------OPENING MARKING JOURNAL------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Marking journal %s opened, %d marks recovered from a previous run!\n", MARKING_JOURNAL, marks_recovered);
+    return journal_fd;
+}
+
+/**
+ * @brief Append one mark to the marking journal
+ * This is a single write() of a fixed size record to a file opened with O_APPEND, so TAs never need a lock
+ * and the cost does not depend on how big the exam file or the journal is
+ *
+ * @param journal_fd File descriptor of the marking journal
+ * @param exam_index Index of the marked exam in the exam_files[] array
+ * @param exam Pointer to the marked exam in shared memory
+ * @param question The question (0 based) that was marked
+ * @param ta Number of the TA who marked it
+ */
+void append_journal_record(int journal_fd, int exam_index, exam_file_shared_data *exam, int question, int ta)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    journal_record record = {
+        .exam_index = exam_index,
+        .student_number = exam->student_number,
+        .question = question,
+        .ta = ta,
+        .rubric_version = exam->rubric_version[question],
+        .timestamp_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec,
+    };
+
+    if (write(journal_fd, &record, sizeof(record)) != (ssize_t)sizeof(record))
+        fprintf(stderr, "TA #%d failed to append to the marking journal!\n", ta);
+}
+
+/**
+ * @brief Write every remaining mark to the exam files and empty the marking journal
+ * Only called from main() once every TA has terminated
+ *
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param journal_fd File descriptor of the marking journal
+ */
+void close_marking_journal(exam_table_shared_data *table, char **exam_files, int journal_fd)
+{
+    int exams_written = checkpoint_exam_files(table, exam_files, journal_fd);
+
+    reset_marking_journal(journal_fd);
+    unlink(MARKING_JOURNAL_CHECKPOINT);
+    close(journal_fd);
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------COMPACTING MARKING JOURNAL------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Marking journal compacted, %d exam files written!\n", exams_written);
+}
+
+/**
+ * @brief Check that a mapped exam file has the fixed layout the mmap mode relies on
+ * A 4 digit student number and a newline, then one 0 or 1 and a newline per question (the very last newline may be missing)
+ *
+ * @param map Start of the mapped exam file
+ * @param size Size of the exam file in bytes
+ * @return int 1 if the layout is valid, 0 if not
+ */
+int exam_file_layout_valid(const char *map, size_t size)
+{
+    size_t full_size = EXAM_FILE_STATUS_OFFSET + 2 * QUESTIONS_PER_EXAM;
+    if (size != full_size && size != full_size - 1)
+        return 0;
+
+    for (int i = 0; i < EXAM_FILE_STATUS_OFFSET - 1; i++)
+    {
+        if (map[i] < '0' || map[i] > '9')
+            return 0;
+    }
+    if (map[EXAM_FILE_STATUS_OFFSET - 1] != '\n')
+        return 0;
+
+    for (int q = 0; q < QUESTIONS_PER_EXAM; q++)
+    {
+        size_t status_offset = EXAM_FILE_STATUS_OFFSET + 2 * q;
+        if (map[status_offset] != '0' && map[status_offset] != '1')
+            return 0;
+        if (status_offset + 1 < size && map[status_offset + 1] != '\n')
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Map every exam file into memory so TAs can mark questions with a single byte store
+ * The mappings are MAP_SHARED, so they stay valid in every TA process forked afterwards and the stores go straight to the file
+ *
+ * @param exam_files Array of all the exam files in exams/
+ * @param exam_count Number of exams in the exam_files[] array
+ * @return char** Array with the mapping of every exam file, indexed like exam_files[], or NULL if any file could not be mapped or has the wrong layout
+ */
+char **map_exam_files(char **exam_files, int exam_count)
+{
+    char **exam_maps = calloc(exam_count, sizeof(char *));
+    if (exam_maps == NULL)
+        return NULL;
+
+    for (int i = 0; i < exam_count; i++)
+    {
+        char file_path[256];
+        snprintf(file_path, sizeof(file_path), "exams/%s.txt", exam_files[i]);
+
+        int fd = open(file_path, O_RDWR);
+        struct stat file_stat;
+        if (fd == -1 || fstat(fd, &file_stat) == -1)
+        {
+            fprintf(stderr, "Could not open %s.txt file for mapping!\n", exam_files[i]);
+            if (fd != -1)
+                close(fd);
+            unmap_exam_files(exam_maps, exam_count);
+            return NULL;
+        }
+
+        char *map = mmap(0, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+        {
+            fprintf(stderr, "Failed to map %s.txt file!\n", exam_files[i]);
+            unmap_exam_files(exam_maps, exam_count);
+            return NULL;
+        }
+
+        exam_maps[i] = map;
+        if (!exam_file_layout_valid(map, file_stat.st_size))
+        {
+            fprintf(stderr, "%s.txt does not have the fixed exam layout, it can't be marked in place!\n", exam_files[i]);
+            unmap_exam_files(exam_maps, exam_count);
+            return NULL;
+        }
+    }
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------MAPPING EXAM FILES INTO MEMORY------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("All %d exam files mapped, questions will be marked in place!\n", exam_count);
+    return exam_maps;
+}
+
+/**
+ * @brief Mark a question directly in the mapped exam file
+ * Every question has its own byte in the file, so TAs marking different questions of the same exam never need a lock
+ *
+ * @param exam_map Mapping of the exam file from map_exam_files()
+ * @param question The question (0 based) that was marked
+ * @param sync_to_disk If 1, msync() the page holding the byte so the mark is on disk before we return
+ */
+void mark_exam_file_in_place(char *exam_map, int question, int sync_to_disk)
+{
+    exam_map[EXAM_FILE_STATUS_OFFSET + 2 * question] = '1';
+
+    // exam files are only a few bytes, so the whole file is on the first page of the mapping
+    if (sync_to_disk)
+        msync(exam_map, EXAM_FILE_STATUS_OFFSET + 2 * QUESTIONS_PER_EXAM - 1, MS_SYNC);
+}
+
+/**
+ * @brief Unmap every exam file mapped by map_exam_files() and free the array
+ *
+ * @param exam_maps Array with the mapping of every exam file, entries that were never mapped are NULL
+ * @param exam_count Number of exams in the array
+ */
+void unmap_exam_files(char **exam_maps, int exam_count)
+{
+    for (int i = 0; i < exam_count; i++)
+    {
+        if (exam_maps[i] != NULL)
+            munmap(exam_maps[i], EXAM_FILE_STATUS_OFFSET + 2 * QUESTIONS_PER_EXAM - 1);
+    }
+    free(exam_maps);
+}
+
+/**
+ * @brief Size in bytes of an exam store holding exam_count records
+ *
+ * @param exam_count Number of exams in the store
+ * @return size_t Size of the header plus every record
+ */
+size_t exam_store_size(int exam_count)
+{
+    return sizeof(exam_store) + sizeof(exam_store_record) * (size_t)exam_count;
+}
+
+/**
+ * @brief Pack every exam file in exams/ into the exam store
+ * The store is built in memory and written out with write_exam_store()
+ *
+ * @return int 0 on success, -1 if any exam could not be loaded or the store could not be written
+ */
+int import_exam_store()
+{
+    int exam_count;
+    char **exam_files = list_exams(&exam_count);
+    if (exam_files == NULL)
+    {
+        fprintf(stderr, "Failed to list the exams to import!\n");
+        return -1;
+    }
+
+    size_t store_size = exam_store_size(exam_count);
+    exam_store *store = calloc(1, store_size);
+    if (store == NULL)
+    {
+        fprintf(stderr, "Failed to allocate the exam store!\n");
+        free(exam_files);
+        return -1;
+    }
+    store->magic = EXAM_STORE_MAGIC;
+    store->version = EXAM_STORE_VERSION;
+    store->record_size = sizeof(exam_store_record);
+    store->exam_count = exam_count;
+
+    for (int i = 0; i < exam_count; i++)
+    {
+        exam_file_shared_data exam;
+        if (strlen(exam_files[i]) >= EXAM_STORE_NAME_LENGTH || !load_exam(&exam, exam_files[i]) || !exam.entries_loaded)
+        {
+            fprintf(stderr, "Failed to import exam %s!\n", exam_files[i]);
+            free(store);
+            free(exam_files);
+            return -1;
+        }
+
+        exam_store_record *record = &store->records[i];
+        strcpy(record->exam_name, exam_files[i]);
+        record->student_number = exam.student_number;
+        atomic_init(&record->question_status, atomic_load(&exam.question_status));
+    }
+
+    int result = write_exam_store(store, store_size);
+    free(store);
+    free(exam_files);
+    if (result == -1)
+        return -1;
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------IMPORTING EXAM FILES INTO EXAM STORE------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("All %d exam files packed into %s!\n", exam_count, EXAM_STORE);
+    return 0;
+}
+
+/**
+ * @brief Write a whole exam store to EXAM_STORE_TMP with a single write() and rename it over EXAM_STORE
+ *
+ * @param store The exam store, built in memory
+ * @param store_size Size of the store from exam_store_size()
+ * @return int 0 on success, -1 if the store could not be written
+ */
+int write_exam_store(exam_store *store, size_t store_size)
+{
+    int fd = open(EXAM_STORE_TMP, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1 || write(fd, store, store_size) != (ssize_t)store_size || fsync(fd) == -1 || close(fd) == -1 ||
+        rename(EXAM_STORE_TMP, EXAM_STORE) == -1)
+    {
+        fprintf(stderr, "Could not write the exam store %s!\n", EXAM_STORE);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Fill the exam store with a synthetic pile of exams, for benchmarking piles much bigger than exams/
+ * Exams are named exam1, exam2, ... and get student numbers counting up from 1000, skipping 9999
+ * Every exam has QUESTIONS_PER_EXAM questions, the first questions_to_mark start out unmarked and the rest already marked
+ *
+ * @param exam_count Number of exams in the pile
+ * @param questions_to_mark Number of questions the TAs have to mark on every exam, 1 to QUESTIONS_PER_EXAM
+ * @param sentinel_at Index of the exam that gets student number 9999 and stops the run, -1 for none
+ * @return int 0 on success, -1 if the store could not be allocated or written
+ */
+int generate_exam_store(int exam_count, int questions_to_mark, int sentinel_at)
+{
+    size_t store_size = exam_store_size(exam_count);
+    exam_store *store = calloc(1, store_size);
+    if (store == NULL)
+    {
+        fprintf(stderr, "Failed to allocate the exam store!\n");
+        return -1;
+    }
+    store->magic = EXAM_STORE_MAGIC;
+    store->version = EXAM_STORE_VERSION;
+    store->record_size = sizeof(exam_store_record);
+    store->exam_count = exam_count;
+
+    unsigned int premarked = ALL_QUESTIONS_MASK & ~((1u << questions_to_mark) - 1u);
+    for (int i = 0; i < exam_count; i++)
+    {
+        exam_store_record *record = &store->records[i];
+        snprintf(record->exam_name, EXAM_STORE_NAME_LENGTH, "exam%d", i + 1);
+        record->student_number = i == sentinel_at ? 9999 : 1000 + i % 8999; // 1000 to 9998, so only the sentinel is 9999
+        atomic_init(&record->question_status, premarked);
+    }
+
+    int result = write_exam_store(store, store_size);
+    free(store);
+    if (result == -1)
+        return -1;
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------GENERATING EXAM STORE------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("%d synthetic exams with %d questions to mark written to %s!\n", exam_count, questions_to_mark, EXAM_STORE);
+    return 0;
+}
+
+/**
+ * @brief Check that an exam name read from the exam store is safe to build "exams/<name>.txt" from
+ * The name has to end inside its field, must not be empty and must not contain '/' or "..", so a corrupt or crafted
+ * store can neither make us read past the record nor write outside exams/ when it is exported
+ *
+ * @param name The exam_name field of a record
+ * @return int 1 if the name is valid, 0 otherwise
+ */
+int exam_store_name_valid(const char *name)
+{
+    if (memchr(name, '\0', EXAM_STORE_NAME_LENGTH) == NULL || name[0] == '\0')
+        return 0;
+    return strchr(name, '/') == NULL && strstr(name, "..") == NULL;
+}
+
+/**
+ * @brief Map the exam store so it can be read and marked in place
+ * Opening the store is an open(), fstat() and mmap() no matter how many exams it holds
+ *
+ * @param store_size Where to store the size of the mapping, needed to unmap it again
+ * @return exam_store* Pointer to the mapped exam store, or NULL if it is missing, not a valid store or holds an invalid exam name
+ */
+exam_store *map_exam_store(size_t *store_size)
+{
+    int fd = open(EXAM_STORE, O_RDWR);
+    struct stat store_stat;
+    if (fd == -1 || fstat(fd, &store_stat) == -1)
+    {
+        fprintf(stderr, "Could not open the exam store %s, create it with --import-exams first!\n", EXAM_STORE);
+        if (fd != -1)
+            close(fd);
+        return NULL;
+    }
+
+    if ((size_t)store_stat.st_size < sizeof(exam_store))
+    {
+        fprintf(stderr, "%s is too small to be an exam store!\n", EXAM_STORE);
+        close(fd);
+        return NULL;
+    }
+
+    exam_store *store = mmap(0, store_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (store == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the exam store %s!\n", EXAM_STORE);
+        return NULL;
+    }
+
+    if (store->magic != EXAM_STORE_MAGIC || store->version != EXAM_STORE_VERSION ||
+        store->record_size != sizeof(exam_store_record) || store->exam_count < 0 ||
+        exam_store_size(store->exam_count) != (size_t)store_stat.st_size)
+    {
+        fprintf(stderr, "%s is not an exam store this marker can read, import the exams again!\n", EXAM_STORE);
+        munmap(store, store_stat.st_size);
+        return NULL;
+    }
+
+    for (int i = 0; i < store->exam_count; i++)
+    {
+        if (!exam_store_name_valid(store->records[i].exam_name))
+        {
+            fprintf(stderr, "Record %d of %s does not hold a valid exam name, import the exams again!\n", i, EXAM_STORE);
+            munmap(store, store_stat.st_size);
+            return NULL;
+        }
+    }
+
+    *store_size = store_stat.st_size;
+    return store;
+}
+
+/**
+ * @brief Build the exam_files[] array from the exam store, the names point straight into the mapped records
+ *
+ * @param store Pointer to the mapped exam store
+ * @return char** Array of exam names indexed like store->records[], or NULL if it could not be allocated
+ */
+char **exam_store_names(exam_store *store)
+{
+    char **exam_files = malloc(sizeof(char *) * (size_t)(store->exam_count > 0 ? store->exam_count : 1));
+    if (exam_files == NULL)
+        return NULL;
+
+    for (int i = 0; i < store->exam_count; i++)
+        exam_files[i] = store->records[i].exam_name;
+    return exam_files;
+}
+
+/**
+ * @brief Load every record of the exam store into the shared memory exam table, without touching exams/
+ *
+ * @param table Pointer to the exam table in shared memory, created for store->exam_count exams
+ * @param store Pointer to the mapped exam store, the record for table->exams[i] is store->records[i]
+ */
+void load_exam_table_from_store(exam_table_shared_data *table, exam_store *store)
+{
+    for (int i = 0; i < table->exam_count; i++)
+    {
+        exam_file_shared_data *exam = &table->exams[i];
+        unsigned int status_bits = atomic_load(&store->records[i].question_status);
+
+        exam->student_number = store->records[i].student_number;
+        atomic_store(&exam->question_status, status_bits);
+        atomic_store(&exam->question_claimed, status_bits); // questions already marked in the store can never be claimed again
+        exam->materialized_status = status_bits;
+        memcpy(exam->rubric_version, store->records[i].rubric_version, sizeof(exam->rubric_version));
+        exam->entries_loaded = 1;
+    }
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------LOADING EXAM STORE INTO SHARED MEMORY------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("All %d exams loaded from %s into the shared memory exam table!\n", table->exam_count, EXAM_STORE);
+}
+
+/**
+ * @brief Mark a question directly in the mapped exam store
+ *
+ * @param record The exam's record in the mapped exam store
+ * @param question The question (0 based) that was marked
+ * @param ta Number of the TA who marked the question
+ * @param rubric_version Version of the rubric the question was marked against
+ */
+void mark_exam_store_record(exam_store_record *record, int question, int ta, unsigned int rubric_version)
+{
+    record->marked_by[question] = ta;
+    record->rubric_version[question] = rubric_version;
+    atomic_fetch_or(&record->question_status, 1u << question);
+}
+
+/**
+ * @brief Flush the exam store to disk and unmap it
+ *
+ * @param store Pointer to the mapped exam store
+ * @param store_size Size of the mapping from map_exam_store()
+ */
+void unmap_exam_store(exam_store *store, size_t store_size)
+{
+    msync(store, store_size, MS_SYNC);
+    munmap(store, store_size);
+}
+
+/**
+ * @brief Write every record of the exam store back out to exams/ in the text layout load_exam() reads
+ *
+ * @return int 0 on success, -1 if the store could not be read or any exam file could not be written
+ */
+int export_exam_store()
+{
+    size_t store_size;
+    exam_store *store = map_exam_store(&store_size);
+    if (store == NULL)
+        return -1;
+
+    int result = 0;
+    for (int i = 0; i < store->exam_count; i++)
+    {
+        exam_file_shared_data exam;
+        exam.student_number = store->records[i].student_number;
+        if (write_exam_file(&exam, store->records[i].exam_name, atomic_load(&store->records[i].question_status)) == -1)
+            result = -1;
+    }
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------EXPORTING EXAM STORE TO EXAM FILES------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("%d exams written from %s to exams/!\n", store->exam_count, EXAM_STORE);
+
+    unmap_exam_store(store, store_size);
+    return result;
+}
+
+/**
+ * @brief Create the Shared Memory event log with one event ring for every TA
+ *
+ * @param num_ta_processes Number of TAs that need their own ring
+ * @return *event_log A pointer to the event log in shared memory
+ */
+event_log *createSharedMemEventLog(int num_ta_processes)
+{
+    // remove name of the event log if it already exists, no error occurs if not
+    shm_unlink(SHARED_EVENT_LOG);
+
+    // create the shared memory event log
+    int shm_fd = shm_open(SHARED_EVENT_LOG, O_CREAT | O_RDWR, 0666);
+    if (shm_fd == -1)
+    {
+        fprintf(stderr, "Failed to create event log!\n");
+        return NULL;
+    }
+
+    // configure the size of the shared memory event log, the rings start out empty since the object is zero filled
+    size_t log_size = sizeof(event_log) + sizeof(ta_event_ring) * (size_t)num_ta_processes;
+    if (ftruncate(shm_fd, log_size) == -1)
+    {
+        fprintf(stderr, "Failed to configure the size of event log!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    // map the shared memory event log into our memory space
+    event_log *log_ptr = mmap(0, log_size,
+                              PROT_READ | PROT_WRITE, MAP_SHARED,
+                              shm_fd, 0);
+    if (log_ptr == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the shared memory event log!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    close(shm_fd);
+    log_ptr->ta_count = num_ta_processes;
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR EVENT LOG------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Shared memory object for the event log has been created!\n");
+    return log_ptr;
+}
+
+/**
+ * @brief Push one event onto a TA's event ring, the logger process formats and prints it later
+ * Only the owning TA ever pushes to its ring, so this is a plain store of the record followed by a release store of head,
+ * no lock and no system call. If the logger has fallen a whole ring behind we give it a little time, then drop the event
+ *
+ * @param ring The calling TA's event ring
+ * @param type One of the EVENT_ types
+ * @param ta Number of the TA the event is about
+ * @param exam_index Index of the exam in the exam_files[] array, -1 if the event is not about an exam
+ * @param question The question (0 based) the event is about, -1 if none
+ * @param value Event specific value, see the EVENT_ types
+ * @param detail Second event specific value, see the EVENT_ types
+ */
+void log_event(ta_event_ring *ring, int type, int ta, int exam_index, int question, int value, int detail)
+{
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    int yields = 0;
+    while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= EVENT_RING_CAPACITY)
+    {
+        if (yields++ == EVENT_RING_FULL_YIELDS)
+        {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return;
+        }
+        sched_yield();
+    }
+
+    event_record *event = &ring->events[head % EVENT_RING_CAPACITY];
+    event->timestamp_ns = now_nanoseconds();
+    event->type = (uint16_t)type;
+    event->ta = (uint16_t)ta;
+    event->exam_index = exam_index;
+    event->question = question;
+    event->value = value;
+    event->detail = detail;
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief Get the name of an event type, as used in the JSON log
+ *
+ * @param type One of the EVENT_ types
+ * @return const char* Name of the event type
+ */
+const char *event_type_name(int type)
+{
+    switch (type)
+    {
+    case EVENT_RUBRIC_REVIEW:
+        return "rubric_review";
+    case EVENT_RUBRIC_LOCKED:
+        return "rubric_locked";
+    case EVENT_RUBRIC_FIXED:
+        return "rubric_fixed";
+    case EVENT_RUBRIC_WRAPPED:
+        return "rubric_wrapped";
+    case EVENT_RUBRIC_PUBLISHED:
+        return "rubric_published";
+    case EVENT_RUBRIC_UNLOCKED:
+        return "rubric_unlocked";
+    case EVENT_RUBRIC_OK:
+        return "rubric_ok";
+    case EVENT_EXAM_LOADED:
+        return "exam_loaded";
+    case EVENT_QUESTION_TAKEN_OVER:
+        return "question_taken_over";
+    case EVENT_QUESTION_MARKED:
+        return "question_marked";
+    case EVENT_STALE_RUBRIC:
+        return "stale_rubric";
+    case EVENT_MARK_SAVED:
+        return "mark_saved";
+    case EVENT_EXAM_LOCKED:
+        return "exam_locked";
+    case EVENT_EXAM_UNLOCKED:
+        return "exam_unlocked";
+    case EVENT_EXAM_MARKED:
+        return "exam_marked";
+    case EVENT_EXAM_LOCK_REPAIRED:
+        return "exam_lock_repaired";
+    case EVENT_RUBRIC_LOCK_REPAIRED:
+        return "rubric_lock_repaired";
+    case EVENT_TA_STARTED:
+        return "ta_started";
+    case EVENT_QUESTION_STARTED:
+        return "question_started";
+    case EVENT_SHUTDOWN_REQUESTED:
+        return "shutdown_requested";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Write one event as text, the same lines TAs used to print themselves
+ *
+ * @param out Where to write the event
+ * @param event The event to write
+ * @param table Pointer to the exam table in shared memory, for student numbers
+ * @param exam_files Array of all the exam files in exams/, for exam names
+ */
+void format_event_text(FILE *out, const event_record *event, exam_table_shared_data *table, char **exam_files)
+{
+    int ta = event->ta;
+    const char *exam_file_name = event->exam_index >= 0 ? exam_files[event->exam_index] : "";
+    int student_number = event->exam_index >= 0 ? table->exams[event->exam_index].student_number : 0;
+
+    switch (event->type)
+    {
+    case EVENT_RUBRIC_REVIEW:
+        fprintf(out, ANSI_COLOR_RED "\n------------CORRECTING RUBRIC------------" ANSI_COLOR_RESET "\n");
+        break;
+    case EVENT_RUBRIC_LOCKED:
+        fprintf(out, ANSI_COLOR_RED "\n------------TA #%d (PID: %d) LOCKING RUBRIC FOR RUBRIC CORRECTING------------" ANSI_COLOR_RESET "\n", ta, event->value);
+        break;
+    case EVENT_RUBRIC_FIXED:
+        fprintf(out, "TA #%d found rubric value %c incorrect. Correcting to %c!\n", ta, event->value, event->detail);
+        break;
+    case EVENT_RUBRIC_WRAPPED:
+        fprintf(out, "TA #%d Reached maximum ASCII Value, resetting to %c whose ASCII value is %d\n", ta, 33, 33);
+        break;
+    case EVENT_RUBRIC_PUBLISHED:
+        fprintf(out, "TA #%d published rubric version %d\n", ta, event->value);
+        break;
+    case EVENT_RUBRIC_UNLOCKED:
+        fprintf(out, ANSI_COLOR_RED "\n------------TA #%d (PID: %d) UNLOCKING RUBRIC FROM RUBRIC CORRECTING------------" ANSI_COLOR_RESET "\n", ta, event->value);
+        break;
+    case EVENT_RUBRIC_OK:
+        fprintf(out, "TA #%d found rubric value %c correct!\n", ta, event->value);
+        break;
+    case EVENT_EXAM_LOADED:
+        fprintf(out, "TA #%d claimed exam %s for student %04d and queued %d questions\n", ta, exam_file_name, student_number, event->value);
+        break;
+    case EVENT_QUESTION_TAKEN_OVER:
+        fprintf(out, "TA #%d took over question %d on exam %s, it was never started or its lease expired\n",
+                ta, event->question + 1, exam_file_name);
+        break;
+    case EVENT_QUESTION_MARKED:
+        fprintf(out, ANSI_COLOR_RED "\n------------CORRECTING EXAM QUESTION------------" ANSI_COLOR_RESET "\n");
+        fprintf(out, "TA #%d marked question %d on exam %s for student %04d using rubric answer %c (rubric version %d)\n",
+                ta, event->question + 1, exam_file_name, student_number, event->value, event->detail);
+        break;
+    case EVENT_STALE_RUBRIC:
+        fprintf(out, "TA #%d marked question %d on exam %s against rubric version %d, the rubric is now at version %d\n",
+                ta, event->question + 1, exam_file_name, event->value, event->detail);
+        break;
+    case EVENT_MARK_SAVED:
+        if (event->value == EXAM_IO_STORE)
+            fprintf(out, ANSI_COLOR_RED "\n------------MARKING EXAM QUESTION CORRECT IN EXAM STORE------------" ANSI_COLOR_RESET "\n");
+        else if (event->value == EXAM_IO_MMAP)
+            fprintf(out, ANSI_COLOR_RED "\n------------MARKING EXAM QUESTION CORRECT IN MAPPED EXAM FILE------------" ANSI_COLOR_RESET "\n");
+        else if (event->value == EXAM_IO_JOURNAL)
+            fprintf(out, ANSI_COLOR_RED "\n------------RECORDING EXAM QUESTION IN MARKING JOURNAL------------" ANSI_COLOR_RESET "\n");
+        else
+            fprintf(out, ANSI_COLOR_RED "\n------------MARKING EXAM QUESTION CORRECT ON EXAM FILE------------" ANSI_COLOR_RESET "\n");
+        fprintf(out, "TA #%d %s question %d on exam %s for student %04d as marked!\n",
+                ta, event->value == EXAM_IO_JOURNAL ? "recorded" : "modified", event->question + 1, exam_file_name, student_number);
+        break;
+    case EVENT_EXAM_LOCKED:
+        fprintf(out, ANSI_COLOR_RED "\n------------TA #%d (PID: %d) LOCKING SEMAPHORE (STRIPE %d) FOR EXAM FILE WRITING------------" ANSI_COLOR_RESET "\n", ta, event->detail, event->value);
+        break;
+    case EVENT_EXAM_UNLOCKED:
+        fprintf(out, ANSI_COLOR_RED "\n------------TA #%d (PID: %d) UNLOCKING SEMAPHORE (STRIPE %d) FROM EXAM FILE WRITING------------" ANSI_COLOR_RESET "\n", ta, event->detail, event->value);
+        break;
+    case EVENT_EXAM_MARKED:
+        fprintf(out, "Exam %s for student %04d is fully marked!\n", exam_file_name, student_number);
+        break;
+    case EVENT_EXAM_LOCK_REPAIRED:
+        fprintf(out, "TA #%d took over semaphore stripe %d from a TA that died holding it, %d exam files were rewritten\n", ta, event->value, event->detail);
+        break;
+    case EVENT_RUBRIC_LOCK_REPAIRED:
+        fprintf(out, "TA #%d took over the rubric lock from a TA that died holding it, %d entries repaired and version %d published\n", ta, event->value, event->detail);
+        break;
+    case EVENT_TA_STARTED:
+        if (event->detail)
+            fprintf(out, " --- TA thread #%d created - thread ID is %d --- \n", ta, event->value);
+        else
+            fprintf(out, " --- TA Process #%d created - PID is %d --- \n", ta, event->value);
+        break;
+    case EVENT_QUESTION_STARTED:
+        fprintf(out, ANSI_COLOR_RED "\n------------MARKING EXAM QUESTION------------" ANSI_COLOR_RESET "\n");
+        fprintf(out, "TA #%d started marking question %d on exam %s for student %04d\n", ta, event->question + 1, exam_file_name, student_number);
+        break;
+    case EVENT_SHUTDOWN_REQUESTED:
+        fprintf(out, ANSI_COLOR_RED "\n------------STUDENT NUMBER 9999 DETECTED. STOPPING MARKING NOW.------------" ANSI_COLOR_RESET "\n");
+        fprintf(out, "TA #%d reached student number 9999 on exam %s\n", ta, exam_file_name);
+        break;
+    }
+}
+
+/**
+ * @brief Write a string as a quoted JSON string, escaping quotes, backslashes and control characters
+ *
+ * @param out Where to write the string
+ * @param text The string to write
+ */
+void write_json_string(FILE *out, const char *text)
+{
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)text; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(out, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(out, "\\u%04x", *c);
+        else
+            fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * @brief Write one event as a single line JSON object
+ *
+ * @param out Where to write the event
+ * @param event The event to write
+ * @param table Pointer to the exam table in shared memory, for student numbers
+ * @param exam_files Array of all the exam files in exams/, for exam names
+ */
+void format_event_json(FILE *out, const event_record *event, exam_table_shared_data *table, char **exam_files)
+{
+    fprintf(out, "{\"timestamp_ns\":%llu,\"ta\":%d,\"event\":\"%s\"",
+            (unsigned long long)event->timestamp_ns, event->ta, event_type_name(event->type));
+    if (event->exam_index >= 0)
+    {
+        // exam names come from file names, which may hold anything but '/' and NUL
+        fputs(",\"exam\":", out);
+        write_json_string(out, exam_files[event->exam_index]);
+        fprintf(out, ",\"student\":%d", table->exams[event->exam_index].student_number);
+    }
+    if (event->question >= 0)
+        fprintf(out, ",\"question\":%d", event->question + 1);
+    fprintf(out, ",\"value\":%d,\"detail\":%d}\n", event->value, event->detail);
+}
+
+/**
+ * @brief Format and print every event waiting in a TA's ring, then hand the slots back to the TA
+ *
+ * @param ring The TA's event ring
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param log_format LOG_FORMAT_TEXT or LOG_FORMAT_JSON
+ * @return int Number of events printed
+ */
+int drain_event_ring(ta_event_ring *ring, exam_table_shared_data *table, char **exam_files, int log_format)
+{
+    unsigned long long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    for (unsigned long long k = tail; k < head; k++)
+    {
+        const event_record *event = &ring->events[k % EVENT_RING_CAPACITY];
+        if (log_format == LOG_FORMAT_JSON)
+            format_event_json(stdout, event, table, exam_files);
+        else
+            format_event_text(stdout, event, table, exam_files);
+    }
+
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+    return (int)(head - tail);
+}
+
+/**
+ * @brief Fork the logger process, it prints the events TAs push onto their rings until main() tells it to stop
+ * The logger writes to a fully buffered stdout, so a whole batch of events goes out in one write
+ *
+ * @param events Pointer to the event log in shared memory
+ * @param table Pointer to the exam table in shared memory
+ * @param exam_files Array of all the exam files in exams/
+ * @param log_format LOG_FORMAT_TEXT or LOG_FORMAT_JSON
+ * @return pid_t PID of the logger process
+ */
+pid_t create_logger_process(event_log *events, exam_table_shared_data *table, char **exam_files, int log_format)
+{
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        printf("Logger process could not be created!\n");
+        exit(1);
+    }
+    if (pid > 0)
+        return pid;
+
+    static char stdout_buffer[EVENT_LOG_STDOUT_BUFFER];
+    setvbuf(stdout, stdout_buffer, _IOFBF, sizeof(stdout_buffer));
+
+    // stop only once main() says every TA is done and nothing is left in any ring
+    while (1)
+    {
+        int stopping = atomic_load(&events->shutdown);
+
+        int printed = 0;
+        for (int i = 0; i < events->ta_count; i++)
+            printed += drain_event_ring(&events->rings[i], table, exam_files, log_format);
+        fflush(stdout);
+
+        if (printed == 0)
+        {
+            if (stopping)
+                break;
+            usleep(EVENT_LOG_POLL_MICROSECONDS);
+        }
+    }
+
+    unsigned long long dropped = 0;
+    for (int i = 0; i < events->ta_count; i++)
+        dropped += atomic_load(&events->rings[i].dropped);
+    if (dropped > 0)
+        fprintf(stderr, "Event logger dropped %llu events because a TA's event ring was full!\n", dropped);
+
+    fflush(stdout);
+    exit(0);
+}
+
+/**
+ * @brief Create the Shared Memory statistics block with one set of latency histograms for main() and every TA
+ *
+ * @param num_ta_processes Number of TAs that need their own set of histograms
+ * @return *stats_block A pointer to the statistics block in shared memory
+ */
+stats_block *createSharedMemStats(int num_ta_processes)
+{
+    // remove name of the statistics block if it already exists, no error occurs if not
+    shm_unlink(SHARED_STATS);
+
+    // create the shared memory statistics block
+    int shm_fd = shm_open(SHARED_STATS, O_CREAT | O_RDWR, 0666);
+    if (shm_fd == -1)
+    {
+        fprintf(stderr, "Failed to create statistics block!\n");
+        return NULL;
+    }
+
+    // configure the size of the shared memory statistics block, the histograms start out empty since the object is zero filled
+    size_t stats_size = sizeof(stats_block) + sizeof(latency_stats) * (size_t)(num_ta_processes + 1);
+    if (ftruncate(shm_fd, stats_size) == -1)
+    {
+        fprintf(stderr, "Failed to configure the size of statistics block!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    // map the shared memory statistics block into our memory space
+    stats_block *stats_ptr = mmap(0, stats_size,
+                                  PROT_READ | PROT_WRITE, MAP_SHARED,
+                                  shm_fd, 0);
+    if (stats_ptr == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the shared memory statistics block!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    close(shm_fd);
+    stats_ptr->ta_count = num_ta_processes;
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING SHARED MEMORY OBJECT FOR LATENCY STATISTICS------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Shared memory object for the latency statistics has been created!\n");
+    return stats_ptr;
+}
+
+/**
+ * @brief Find the histogram bucket a latency falls into
+ * Small values get a bucket each, larger ones are grouped by their highest bit and the HISTOGRAM_SUB_BUCKET_BITS bits below it
+ *
+ * @param value_ns Latency in nanoseconds
+ * @return int Index into latency_histogram.buckets[]
+ */
+int histogram_bucket(uint64_t value_ns)
+{
+    if (value_ns < HISTOGRAM_SUB_BUCKETS)
+        return (int)value_ns;
+
+    int highest_bit = 63 - __builtin_clzll(value_ns);
+    int shift = highest_bit - HISTOGRAM_SUB_BUCKET_BITS;
+    int sub_bucket = (int)((value_ns >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + sub_bucket;
+}
+
+/**
+ * @brief Get the largest latency that falls into a histogram bucket, percentiles are reported as this value
+ *
+ * @param bucket Index into latency_histogram.buckets[]
+ * @return uint64_t Largest latency in nanoseconds that histogram_bucket() maps to this bucket
+ */
+uint64_t histogram_bucket_limit(int bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS)
+        return (uint64_t)bucket;
+
+    int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t sub_bucket = (uint64_t)(bucket % HISTOGRAM_SUB_BUCKETS);
+    uint64_t lowest = (HISTOGRAM_SUB_BUCKETS + sub_bucket) << shift;
+    return lowest + ((1ULL << shift) - 1);
+}
+
+/**
+ * @brief Record one latency in a histogram of a TA's (or main()'s) statistics
+ * Only the owner of the set ever records into it, so this is a few plain increments with no lock and no atomics
+ *
+ * @param stats The set of histograms belonging to the caller
+ * @param metric Which latency was measured, one of the STAT_ values
+ * @param latency_ns The latency in nanoseconds
+ */
+void record_latency(latency_stats *stats, int metric, unsigned long long latency_ns)
+{
+    latency_histogram *histogram = &stats->metrics[metric];
+    histogram->buckets[histogram_bucket(latency_ns)]++;
+    histogram->count++;
+    histogram->total_ns += latency_ns;
+    if (latency_ns > histogram->max_ns)
+        histogram->max_ns = latency_ns;
+}
+
+/**
+ * @brief Add the counts of one histogram to another
+ *
+ * @param into Histogram to add to
+ * @param from Histogram to add
+ */
+void merge_histogram(latency_histogram *into, const latency_histogram *from)
+{
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+        into->buckets[b] += from->buckets[b];
+    into->count += from->count;
+    into->total_ns += from->total_ns;
+    if (from->max_ns > into->max_ns)
+        into->max_ns = from->max_ns;
+}
+
+/**
+ * @brief Get a percentile of the latencies in a histogram
+ * The answer is the limit of the bucket the percentile falls into, so it is at most 12.5% above the real value and never above the max
+ *
+ * @param histogram Histogram to read
+ * @param percentile Percentile between 0 and 100
+ * @return uint64_t Latency in nanoseconds, 0 if the histogram is empty
+ */
+uint64_t histogram_percentile(const latency_histogram *histogram, double percentile)
+{
+    if (histogram->count == 0)
+        return 0;
+
+    // the rank of the value we want, counting from 1
+    uint64_t rank = (uint64_t)ceil(percentile / 100.0 * (double)histogram->count);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+    {
+        seen += histogram->buckets[b];
+        if (seen >= rank)
+        {
+            uint64_t limit = histogram_bucket_limit(b);
+            return limit < histogram->max_ns ? limit : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+/**
+ * @brief Get the printable name of a latency metric
+ *
+ * @param metric One of the STAT_ values
+ * @return const char* Name of the metric
+ */
+const char *stat_metric_name(int metric)
+{
+    switch (metric)
+    {
+    case STAT_SEMAPHORE_WAIT:
+        return "semaphore wait";
+    case STAT_EXAM_LOCK_HOLD:
+        return "exam lock hold";
+    case STAT_RUBRIC_LOCK_WAIT:
+        return "rubric lock wait";
+    case STAT_RUBRIC_LOCK_HOLD:
+        return "rubric lock hold";
+    case STAT_EXAM_LOADING:
+        return "exam loading";
+    case STAT_LOAD_EXAM:
+        return "load_exam";
+    case STAT_CORRECT_HARDCOPY_EXAM:
+        return "correct_hardcopy_exam";
+    case STAT_MARK_QUESTION:
+        return "mark_question";
+    case STAT_EXAM_END_TO_END:
+        return "exam end to end";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Merge the histograms of main() and every TA into one histogram per metric
+ * Must only be called once every TA has exited, the histograms are read without any synchronization
+ *
+ * @param stats Pointer to the statistics block in shared memory
+ * @param merged Where to store the merged histograms
+ */
+void merge_latency_stats(stats_block *stats, latency_stats *merged)
+{
+    memset(merged, 0, sizeof(*merged));
+    for (int set = 0; set <= stats->ta_count; set++)
+        for (int metric = 0; metric < STAT_METRIC_COUNT; metric++)
+            merge_histogram(&merged->metrics[metric], &stats->sets[set].metrics[metric]);
+}
+
+/**
+ * @brief Print p50, p90, p99 and max of every latency that was recorded at least once, merged over main() and every TA
+ *
+ * @param stats Pointer to the statistics block in shared memory
+ */
+void print_latency_stats(stats_block *stats)
+{
+    latency_stats merged;
+    merge_latency_stats(stats, &merged);
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------LATENCY (MICROSECONDS)------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("%-22s %8s %10s %10s %10s %10s\n", "", "count", "p50", "p90", "p99", "max");
+    for (int metric = 0; metric < STAT_METRIC_COUNT; metric++)
+    {
+        const latency_histogram *histogram = &merged.metrics[metric];
+        if (histogram->count == 0)
+            continue; // i.e., nothing rewrites exam files outside of rewrite mode
+
+        LOG_INFO("%-22s %8llu %10.1f %10.1f %10.1f %10.1f\n",
+                 stat_metric_name(metric),
+                 (unsigned long long)histogram->count,
+                 histogram_percentile(histogram, 50) / 1e3,
+                 histogram_percentile(histogram, 90) / 1e3,
+                 histogram_percentile(histogram, 99) / 1e3,
+                 histogram->max_ns / 1e3);
+    }
+}
+
+/**
+ * @brief Compare two exam names in natural order, so exam2 comes before exam10
+ * Runs of digits are compared by their value, everything else character by character
+ *
+ * @param a First exam name
+ * @param b Second exam name
+ * @return int Less than 0 if a comes first, 0 if they are the same, more than 0 if b comes first
+ */
+int natural_compare(const char *a, const char *b)
+{
+    while (*a != '\0' && *b != '\0')
+    {
+        if (isdigit((unsigned char)*a) && isdigit((unsigned char)*b))
+        {
+            // leading zeros don't change the value, after them the longer run of digits is the bigger number
+            while (*a == '0')
+                a++;
+            while (*b == '0')
+                b++;
+            size_t a_digits = 0, b_digits = 0;
+            while (isdigit((unsigned char)a[a_digits]))
+                a_digits++;
+            while (isdigit((unsigned char)b[b_digits]))
+                b_digits++;
+            if (a_digits != b_digits)
+                return a_digits < b_digits ? -1 : 1;
+
+            int digits_compared = strncmp(a, b, a_digits);
+            if (digits_compared != 0)
+                return digits_compared;
+            a += a_digits;
+            b += b_digits;
+            continue;
+        }
+
+        if (*a != *b)
+            return (unsigned char)*a - (unsigned char)*b;
+        a++;
+        b++;
+    }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+/**
+ * @brief qsort() comparison for an array of exam names, sorts them with natural_compare()
+ *
+ * @param a Pointer to the first exam name in the array
+ * @param b Pointer to the second exam name in the array
+ * @return int Same as natural_compare()
+ */
+int compare_exam_names(const void *a, const void *b)
+{
+    return natural_compare(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief Get an array of exam file names that are contained in the exams/ directory
+ * ex. [exam1, exam2, exam3, etc.]...
+ *
+ * The idea is that if we want to increase or decrease number of exam files in exams/ dir
+ * We can do so without worrying about breaking the rest of the code
+ *
+ * The directory is read once with getdents64(), a big batch of entries per system call, and only *.txt files are kept.
+ * Every name is appended to one string arena that grows by doubling, at the end the arena is moved up behind the array
+ * of pointers into it, so the array and every name live in a single block that is freed with one free().
+ * Exams come back in natural order, i.e., exam1, exam2, ..., exam10 and not the order the directory happens to store them in
+ *
+ * @param exam_count The number of exam files within the exams/ directory
+ * @return char** The array of exam file names, free it with a single free(), or NULL (and an exam_count of 0) if exams/ could not be read
+ */
+char **list_exams(int *exam_count)
+{
+    *exam_count = 0;
+
+    // open the exams/ directory, getdents64() reads it straight from the file descriptor
+    int dir_fd = open("exams/", O_RDONLY | O_DIRECTORY);
+    if (dir_fd == -1)
+    {
+        printf("Could not open the exams/ directory!\n");
+        return NULL;
+    }
+
+    size_t arena_capacity = EXAM_NAME_ARENA_INITIAL;
+    size_t arena_used = 0;
+    int exam_file_count = 0;
+    char *arena = malloc(arena_capacity);
+    if (arena == NULL)
+    {
+        printf("Could not allocate memory for the exam file names!\n");
+        close(dir_fd);
+        return NULL;
+    }
+
+    // getdents64() fills the buffer with as many directory entries as fit, 0 means the end of the directory
+    _Alignas(8) char entries[DIRECTORY_READ_BUFFER];
+    long bytes_read;
+    while ((bytes_read = syscall(SYS_getdents64, dir_fd, entries, sizeof(entries))) > 0)
+    {
+        for (long offset = 0; offset < bytes_read;)
+        {
+            linux_dirent64 *entry = (linux_dirent64 *)(entries + offset);
+            offset += entry->d_reclen;
+
+            // only regular *.txt files are exams, this also skips '.' and '..'
+            size_t len = strlen(entry->d_name);
+            if (len <= 4 || strcmp(entry->d_name + len - 4, ".txt") != 0 ||
+                (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN))
+                continue;
+
+            // remove the .txt extension
+            len -= 4;
+
+            // the array of pointers is put in front of the names at the end, so leave room for it too
+            size_t needed = arena_used + len + 1 + sizeof(char *) * (size_t)(exam_file_count + 1);
+            if (needed > arena_capacity)
+            {
+                while (needed > arena_capacity)
+                    arena_capacity *= 2;
+                char *grown = realloc(arena, arena_capacity);
+                if (grown == NULL)
+                {
+                    printf("Could not allocate memory for the exam file names!\n");
+                    free(arena);
+                    close(dir_fd);
+                    return NULL;
+                }
+                arena = grown;
+            }
+
+            // store (copy) the filename without .txt into the arena
+            memcpy(arena + arena_used, entry->d_name, len);
+            arena[arena_used + len] = '\0';
+            arena_used += len + 1;
+            exam_file_count++;
+        }
+    }
+    close(dir_fd);
+
+    if (bytes_read == -1)
+    {
+        printf("Could not read the exams/ directory!\n");
+        free(arena);
+        return NULL;
+    }
+
+    // move the names up behind the array of pointers, then point every entry at its name in order
+    char **exam_files = (char **)arena;
+    char *names = arena + sizeof(char *) * (size_t)exam_file_count;
+    memmove(names, arena, arena_used);
+    for (int i = 0; i < exam_file_count; i++)
+    {
+        exam_files[i] = names;
+        names += strlen(names) + 1;
+    }
+
+    qsort(exam_files, exam_file_count, sizeof(char *), compare_exam_names);
+
+    *exam_count = exam_file_count; // store the number of total exam files
+    return exam_files;
+}
+
+/**
+ * @brief Helper function to remove specific element from an array
+ * This will be used to remove an already marked question from the array of all question number
+ *
+ * @param arr Array to remove an element from
+ * @param size Size of the array
+ * @param index Index of the element to remove
+ * @return int Returns the size of the new array
+ */
+int remove_by_index(int arr[], int size, int index)
+{
+    if (index < 0 || index >= size)
+        return size;
+
+    for (int i = index; i < size - 1; i++)
+        arr[i] = arr[i + 1];
+
+    return size - 1;
+}
+
+/**
+ * @brief Everything one TA does, from correcting the rubric to running out of questions to mark
+ * The TA is either a forked process or a thread of main(), both run exactly this with the same shared memory objects and locks
+ *
+ * @param ta Everything the TA needs, its own TA index and the shared memory objects
+ */
+void run_ta(const ta_context *ta)
+{
+    int i = ta->ta_index; // the TA's number is i + 1
+    int num_ta_processes = ta->num_ta_processes;
+    rubric_shared_data *rubric = ta->rubric;
+    exam_table_shared_data *table = ta->table;
+    exam_work_queue *queue = ta->queue;
+    ta_task_deque *deques = ta->deques;
+    char **exam_files = ta->exam_files;
+    exam_lock_set *exam_locks = ta->exam_locks;
+    int journal_fd = ta->journal_fd;
+    char **exam_maps = ta->exam_maps;
+    exam_store *store = ta->store;
+    simulation_clock *clock = ta->clock;
+    event_log *events = ta->events;
+    stats_block *stats = ta->stats;
+    shutdown_state *shutdown = ta->shutdown;
+    const marker_options *options = ta->options;
+
+    // pin the TA before it touches anything of its own, so its deque, event ring and statistics end up in memory near its CPU
+    latency_stats *own_stats = &stats->sets[i + 1];
+    own_stats->pinned_cpu = -1;
+    if (ta->ta_cpus != NULL)
+    {
+        if (pin_to_cpus(&ta->ta_cpus[i], 1) == 0)
+            own_stats->pinned_cpu = ta->ta_cpus[i];
+        else
+            fprintf(stderr, "TA %d could not be pinned to CPU %d!\n", i + 1, ta->ta_cpus[i]);
+    }
+    own_stats->started_cpu = sched_getcpu();
+
+    // every TA has its own random number generator, seeded from the run seed and its TA number
+    ta_rng rng;
+    seed_ta_rng(&rng, options->seed, i + 1);
+
+    simulated_delay(clock, i + 1, 1.0); // sleep a little bit to prevent the printout being laggy
+    ta_event_ring *own_events = &events->rings[i];
+    if (options->ta_mode == TA_MODE_THREADS)
+        LOG_EVENT(own_events, EVENT_TA_STARTED, i + 1, -1, -1, (int)gettid(), 1);
+    else
+        LOG_EVENT(own_events, EVENT_TA_STARTED, i + 1, -1, -1, getpid(), 0);
+    // ------ correct the rubric stored in shared memory according to assignment specification ------
+    // markers read the rubric from the seqlock-published copies, check_and_correct_rubric() only takes the writer mutex to correct an entry
+    check_and_correct_rubric(rubric, i + 1, clock, &rng, own_events, own_stats, shutdown);
+
+    ta_task_deque *own_deque = &deques[i];
+    int scan_from = 0; // every exam before this index is known to be fully marked
+
+    // the unit of work is a single (exam, question) task
+    // TAs work through their own deque first, then claim a fresh exam from the work queue,
+    // and once no exams are left they steal tasks from the tail of other TAs' deques
+    // and finally take over questions whose lease expired because their TA died or stalled
+    while (1)
+    {
+        // once the 9999 sentinel is reached nothing new is taken on, a mark already under way was saved before we got here
+        if (shutdown_requested(shutdown))
+            break;
+
+        marking_task task;
+        int taken_over = 0;              // set when reclaim_question() already leased the question for us
+        unsigned long long own_deadline; // deadline of our lease on the question, mark_question() releases it only if it is still ours
+
+        if (!pop_task(own_deque, &task))
+        {
+            int j = claim_next_exam(queue);
+            if (j != -1)
+            {
+                // every exam was loaded into its own record of the shared exam table at startup,
+                // so claiming an exam does not touch the exam file at all
+                exam_file_shared_data *exam_record = &table->exams[j];
+                unsigned long long claimed_at = now_nanoseconds();
+                atomic_store(&exam_record->claimed_at_ns, claimed_at); // whoever marks the last question measures the exam from here
+
+                // array of question numbers, used to push the unmarked questions onto our deque in a random order
+                int question_number_arr[QUESTIONS_PER_EXAM];
+                int length_question_number_arr = QUESTIONS_PER_EXAM;
+                for (int q = 0; q < QUESTIONS_PER_EXAM; q++)
+                    question_number_arr[q] = q;
+
+                int tasks_pushed = 0;
+                while (length_question_number_arr > 0)
+                {
+                    int exam_q_to_mark = ta_rng_below(&rng, length_question_number_arr); // randomly choose the index of the question_number_arr[], i.e., the next question to queue
+
+                    // questions that were already marked in the exam file don't need a task
+                    if (!is_exam_q_marked(exam_record, question_number_arr[exam_q_to_mark]))
+                    {
+                        marking_task new_task = {j, question_number_arr[exam_q_to_mark]};
+                        push_task(own_deque, new_task);
+                        tasks_pushed++;
+                    }
+
+                    // remove the question from question_number_arr[] so it cannot be chosen again
+                    length_question_number_arr =
+                        remove_by_index(question_number_arr,
+                                        length_question_number_arr,
+                                        exam_q_to_mark);
+                }
+
+                record_latency(own_stats, STAT_EXAM_LOADING, now_nanoseconds() - claimed_at);
+                LOG_EVENT(own_events, EVENT_EXAM_LOADED, i + 1, j, -1, tasks_pushed, 0);
+                if (tasks_pushed == 0 && exam_fully_marked(exam_record))
+                    LOG_EVENT(own_events, EVENT_EXAM_MARKED, i + 1, j, -1, 0, 0);
+                continue;
+            }
+
+            // no exams left to claim, so help whichever TA still has questions waiting
+            if (!steal_task(deques, num_ta_processes, i, &rng, &task))
+            {
+                // nothing to steal, take over any question that was never queued or whose lease ran out
+                int reclaim = reclaim_question(table, &scan_from, i + 1, clock->lease_duration_ns, &task, &own_deadline);
+                if (reclaim == -1)
+                    break; // every exam is fully marked
+                if (reclaim == 0)
+                {
+                    // other TAs still hold live leases, check back in case one of them dies or stalls
+                    park_virtual_clock(clock, i + 1);
+                    usleep(clock->lease_poll_microseconds);
+                    unpark_virtual_clock(clock, i + 1);
+                    continue;
+                }
+                taken_over = 1;
+            }
+        }
+
+        char *exam_file_name = exam_files[task.exam_index];
+        exam_file_shared_data *exam_record = &table->exams[task.exam_index];
+        int exam_lock = exam_lock_stripe(task.exam_index);
+
+        // leasing the question is a single compare-and-swap of its deadline, no semaphore needed to mark it
+        if (!taken_over)
+        {
+            int claim = claim_question(exam_record, task.question, i + 1, clock->lease_duration_ns, &own_deadline);
+            if (claim == CLAIM_FAILED)
+                continue;
+            taken_over = claim == CLAIM_RECLAIMED;
+        }
+        if (taken_over)
+            LOG_EVENT(own_events, EVENT_QUESTION_TAKEN_OVER, i + 1, task.exam_index, task.question, 0, 0);
+
+        // check the rubric for this question first, reading it takes no lock and tells us which version we used
+        unsigned int rubric_version;
+        char rubric_text = read_rubric_entry(rubric, task.question, &rubric_version);
+
+        // mark_question() requests the shutdown instead of marking if student number on exam is 9999
+        unsigned long long marking_started = now_nanoseconds();
+        int exam_completed = mark_question(exam_record, task.exam_index, task.question, rubric_version, clock, shutdown, i + 1, &rng, own_events, own_deadline);
+        if (exam_completed == -1)
+            continue;
+        record_latency(own_stats, STAT_MARK_QUESTION, now_nanoseconds() - marking_started);
+        LOG_EVENT(own_events, EVENT_QUESTION_MARKED, i + 1, task.exam_index, task.question, rubric_text, (int)rubric_version);
+
+        // the rubric may have been corrected while we were marking, the mark keeps the version it was made against
+        unsigned int latest_rubric_version = published_rubric_version(rubric);
+        if (latest_rubric_version != rubric_version)
+            LOG_EVENT(own_events, EVENT_STALE_RUBRIC, i + 1, task.exam_index, task.question, (int)rubric_version, (int)latest_rubric_version);
+
+        if (options->exam_io_mode == EXAM_IO_STORE)
+        {
+            // the exam store is mapped, the mark goes straight into the exam's record
+            mark_exam_store_record(&store->records[task.exam_index], task.question, i + 1, rubric_version);
+        }
+        else if (options->exam_io_mode == EXAM_IO_MMAP)
+        {
+            // the exam file is mapped, marking it is a single byte store into the mapping
+            mark_exam_file_in_place(exam_maps[task.exam_index], task.question, options->msync_marks);
+        }
+        else if (options->exam_io_mode == EXAM_IO_JOURNAL)
+        {
+            // recording the mark is one append to the journal, main() writes the exam files at checkpoints
+            append_journal_record(journal_fd, task.exam_index, exam_record, task.question, i + 1);
+        }
+        else
+        {
+            // the exam lock stripe now only keeps two TAs from rewriting the same exam file at once
+            unsigned long long lock_requested = now_nanoseconds();
+            int lock_status = waitSemaphore(exam_locks, exam_lock, i); // lock the exam lock stripe for this exam
+            unsigned long long lock_acquired = now_nanoseconds();
+            record_latency(own_stats, STAT_SEMAPHORE_WAIT, lock_acquired - lock_requested);
+            // if the stripe could not be locked the mark stays in the exam table only, main() writes the exam file once the TAs are done
+            if (lock_status != LOCK_FAILED)
+            {
+                LOG_EVENT(own_events, EVENT_EXAM_LOCKED, i + 1, task.exam_index, task.question, exam_lock, getpid());
+                if (lock_status == LOCK_OWNER_DIED)
+                {
+                    // the TA that held the stripe died, possibly half way through rewriting one of its exam files
+                    int exams_rewritten = repair_exam_stripe(table, exam_files, exam_lock);
+                    LOG_EVENT(own_events, EVENT_EXAM_LOCK_REPAIRED, i + 1, task.exam_index, -1, exam_lock, exams_rewritten);
+                }
+
+                // write the updated question status as marked to the actual exam .txt file in exams/
+                unsigned long long write_started = now_nanoseconds();
+                correct_hardcopy_exam(exam_record, exam_file_name, task.question);
+                record_latency(own_stats, STAT_CORRECT_HARDCOPY_EXAM, now_nanoseconds() - write_started);
+
+                LOG_EVENT(own_events, EVENT_MARK_SAVED, i + 1, task.exam_index, task.question, options->exam_io_mode, 0);
+                LOG_EVENT(own_events, EVENT_EXAM_UNLOCKED, i + 1, task.exam_index, task.question, exam_lock, getpid());
+                record_latency(own_stats, STAT_EXAM_LOCK_HOLD, now_nanoseconds() - lock_acquired);
+                signalSemaphore(exam_locks, exam_lock, i); // unlock the exam lock stripe for this exam
+            }
+        }
+        if (options->exam_io_mode != EXAM_IO_REWRITE)
+            LOG_EVENT(own_events, EVENT_MARK_SAVED, i + 1, task.exam_index, task.question, options->exam_io_mode, 0);
+
+        // only the TA whose mark completed the exam reports it
+        if (exam_completed)
+        {
+            // claimed_at_ns is still 0 if the exam was never claimed, i.e., its TA died before queueing its questions
+            unsigned long long claimed_at = atomic_load(&exam_record->claimed_at_ns);
+            if (claimed_at != 0)
+                record_latency(own_stats, STAT_EXAM_END_TO_END, now_nanoseconds() - claimed_at);
+            LOG_EVENT(own_events, EVENT_EXAM_MARKED, i + 1, task.exam_index, -1, 0, 0);
+        }
+    }
+
+    // every single exam in exam_files[] has been claimed and every task marked, or the run is shutting down, so this TA is done
+    own_stats->finished_ns = now_nanoseconds();
+    own_stats->finished_cpu = sched_getcpu();
+    park_virtual_clock(clock, i + 1);
+}
+
+/**
+ * @brief Create a TA Process to run concurrently with other TA proccesses to mark questions on exams
+ *
+ * @param ta_template Everything the TAs share, the TA index is filled in for every TA
+ * @return pid_t* Return an array containing the pid's of all TA processes
+ */
+pid_t *create_ta_processes(const ta_context *ta_template)
+{
+    int num_ta_processes = ta_template->num_ta_processes;
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING TA'S------------" ANSI_COLOR_RESET "\n");
+
+    // allocate memory to array of TA process ID's so we can wait for them in main
+    pid_t *ta_pids = malloc(sizeof(pid_t) * num_ta_processes);
+    if (ta_pids == NULL)
+    {
+        printf("Could not allocate memory for array to store TA PID's!\n");
+        exit(1);
+    }
+
+    // loop for the amount of ta processes the user specified from the command line arg
+    for (int i = 0; i < num_ta_processes; i++)
+    {
+        LOG_VERBOSE("Creating TA #%d now!\n", i + 1);
+        pid_t pid = fork(); // create the TA process as a CHILD process
+
+        // error in creating the TA process, exit with error
+        if (pid == -1)
+        {
+            printf("TA Process #%d could not be created!\n", i + 1);
+            free(ta_pids); // we can free the array of TA process PID's since we got an error when creating the TA process
+            exit(1);
+        }
+        // success in creating the TA process
+        else if (pid == 0)
+        {
+            ta_context ta = *ta_template;
+            ta.ta_index = i;
+
+            // ------ access the rubric stored in shared memory, the TA process maps it for itself ------
+            ta.rubric = accessSharedMemRubric();
+            if (ta.rubric == (rubric_shared_data *)-1)
+                exit(1);
+
+            run_ta(&ta);
+            exit(0);
+        }
+        else
+        {
+            ta_pids[i] = pid; // ensure the TA process PID get's addedd to the ta_pids array
+        }
+    }
+    return ta_pids;
+}
+
+/**
+ * @brief Create every TA as a thread of main() instead of a process, they share main()'s address space
+ * The TAs run the same run_ta() and use the same shared memory objects and locks as TA processes do
+ *
+ * @param ta_template Everything the TAs share, the TA index is filled in for every TA
+ * @return ta_thread* Array of the TA threads and their contexts, free it once every thread is joined
+ */
+ta_thread *create_ta_threads(const ta_context *ta_template)
+{
+    int num_ta_threads = ta_template->num_ta_processes;
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------CREATING TA THREADS------------" ANSI_COLOR_RESET "\n");
+
+    ta_thread *ta_threads = calloc(num_ta_threads, sizeof(ta_thread));
+    if (ta_threads == NULL)
+    {
+        printf("Could not allocate memory for array to store TA threads!\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < num_ta_threads; i++)
+    {
+        LOG_VERBOSE("Creating TA #%d now!\n", i + 1);
+        ta_threads[i].context = *ta_template;
+        ta_threads[i].context.ta_index = i;
+
+        if (pthread_create(&ta_threads[i].thread, NULL, ta_thread_main, &ta_threads[i]) != 0)
+        {
+            printf("TA Thread #%d could not be created!\n", i + 1);
+            exit(1);
+        }
+    }
+    return ta_threads;
+}
+
+/**
+ * @brief Start routine of a TA thread
+ *
+ * @param ta_thread_ptr The TA's entry in the ta_thread array
+ * @return void* Always NULL
+ */
+void *ta_thread_main(void *ta_thread_ptr)
+{
+    ta_thread *self = ta_thread_ptr;
+    run_ta(&self->context);
+    atomic_store(&self->finished, 1);
+    return NULL;
+}
+
+/**
+ * @brief Join every TA thread that has finished since the last call, without waiting for the others
+ *
+ * @param ta_threads Array of the TA threads from create_ta_threads()
+ * @param num_ta_threads Number of TA threads
+ * @return int Number of TA threads that were joined by this call
+ */
+int join_finished_ta_threads(ta_thread *ta_threads, int num_ta_threads)
+{
+    int joined = 0;
+    for (int i = 0; i < num_ta_threads; i++)
+    {
+        if (ta_threads[i].joined || !atomic_load(&ta_threads[i].finished))
+            continue;
+
+        pthread_join(ta_threads[i].thread, NULL);
+        ta_threads[i].joined = 1;
+        joined++;
+
+        LOG_INFO(ANSI_COLOR_RED "\n------------TERMINATING TA THREAD------------" ANSI_COLOR_RESET "\n");
+        LOG_INFO("TA %d has terminated.\n", i + 1);
+    }
+    return joined;
+}
+
+
+/**
+ * @brief Read the socket and core of every CPU this process may run on
+ * The ids come from /sys/devices/system/cpu/cpu<n>/topology, a CPU without them is put on socket 0 as a core of its own
+ *
+ * @param slots Where to store one slot per CPU, room for CPU_SETSIZE
+ * @return int Number of CPUs found
+ */
+int read_cpu_topology(cpu_slot *slots)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+        return 0;
+
+    int slot_count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+
+        cpu_slot *slot = &slots[slot_count++];
+        slot->cpu = cpu;
+        slot->package = cpu_topology_id(cpu, "physical_package_id", 0);
+        slot->core = cpu_topology_id(cpu, "core_id", cpu);
+    }
+    return slot_count;
+}
+
+/**
+ * @brief Read one topology id of a CPU from sysfs
+ *
+ * @param cpu The CPU number
+ * @param id_name physical_package_id or core_id
+ * @param fallback What to return if the id cannot be read
+ * @return int The id, or fallback
+ */
+int cpu_topology_id(int cpu, const char *id_name, int fallback)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, id_name);
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return fallback;
+
+    int id;
+    if (fscanf(fp, "%d", &id) != 1)
+        id = fallback;
+    fclose(fp);
+    return id;
+}
+
+/**
+ * @brief qsort() comparison that puts CPUs in compact order, socket by socket and core by core, hyperthreads of a core next to each other
+ *
+ * @param a Pointer to the first cpu_slot
+ * @param b Pointer to the second cpu_slot
+ * @return int Less than 0 if a comes first, more than 0 if b comes first
+ */
+int compare_cpu_slots_compact(const void *a, const void *b)
+{
+    const cpu_slot *slot_a = a, *slot_b = b;
+    if (slot_a->package != slot_b->package)
+        return slot_a->package - slot_b->package;
+    if (slot_a->core != slot_b->core)
+        return slot_a->core - slot_b->core;
+    return slot_a->cpu - slot_b->cpu;
+}
+
+/**
+ * @brief qsort() comparison that puts CPUs in scatter order, one CPU of every socket in turn,
+ * and every core of a socket before the second hyperthread of any core
+ *
+ * @param a Pointer to the first cpu_slot, spread_rank must be filled in
+ * @param b Pointer to the second cpu_slot, spread_rank must be filled in
+ * @return int Less than 0 if a comes first, more than 0 if b comes first
+ */
+int compare_cpu_slots_scatter(const void *a, const void *b)
+{
+    const cpu_slot *slot_a = a, *slot_b = b;
+    if (slot_a->spread_rank != slot_b->spread_rank)
+        return slot_a->spread_rank - slot_b->spread_rank;
+    if (slot_a->package != slot_b->package)
+        return slot_a->package - slot_b->package;
+    return slot_a->cpu - slot_b->cpu;
+}
+
+/**
+ * @brief Decide which CPU every TA is pinned to, from the --pin= placement policy
+ * compact fills one socket core by core before the next, scatter spreads TAs over every socket and core first,
+ * and a list of CPUs is used as given. When there are more TAs than CPUs the placement wraps around
+ *
+ * @param options The options the marker was started with
+ * @param num_tas Number of TAs
+ * @return int* The CPU of every TA, indexed by TA index, or NULL if TAs are not pinned
+ */
+int *plan_ta_placement(const marker_options *options, int num_tas)
+{
+    if (options->pin_policy == PIN_NONE)
+        return NULL;
+
+    int *ta_cpus = malloc(sizeof(int) * num_tas);
+    if (ta_cpus == NULL)
+    {
+        printf("Could not allocate memory for the TA placement!\n");
+        exit(1);
+    }
+
+    if (options->pin_policy == PIN_LIST)
+    {
+        for (int i = 0; i < num_tas; i++)
+            ta_cpus[i] = options->pin_cpus[i % options->pin_cpu_count];
+        return ta_cpus;
+    }
+
+    static cpu_slot slots[CPU_SETSIZE];
+    int slot_count = read_cpu_topology(slots);
+    if (slot_count == 0)
+    {
+        fprintf(stderr, "Could not read which CPUs the TAs may run on, TAs will not be pinned!\n");
+        free(ta_cpus);
+        return NULL;
+    }
+
+    qsort(slots, slot_count, sizeof(cpu_slot), compare_cpu_slots_compact);
+    if (options->pin_policy == PIN_SCATTER)
+    {
+        // in compact order, rank every CPU by its position on its socket, counting first hyperthreads of every core before second ones
+        for (int s = 0; s < slot_count; s++)
+        {
+            int sibling = 0, core_position = 0;
+            for (int t = 0; t < s; t++)
+            {
+                if (slots[t].package != slots[s].package)
+                    continue;
+                if (slots[t].core == slots[s].core)
+                    sibling++;
+                else if (t == 0 || slots[t].core != slots[t - 1].core || slots[t].package != slots[t - 1].package)
+                    core_position++;
+            }
+            slots[s].spread_rank = sibling * CPU_SETSIZE + core_position;
+        }
+        qsort(slots, slot_count, sizeof(cpu_slot), compare_cpu_slots_scatter);
+    }
+
+    for (int i = 0; i < num_tas; i++)
+        ta_cpus[i] = slots[i % slot_count].cpu;
+    return ta_cpus;
+}
+
+/**
+ * @brief Restrict the calling process, or the calling thread of a threaded TA, to a set of CPUs
+ *
+ * @param cpus The CPUs to allow
+ * @param cpu_count Number of CPUs in cpus[]
+ * @return int 0 on success, -1 if the affinity could not be set
+ */
+int pin_to_cpus(const int *cpus, int cpu_count)
+{
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int i = 0; i < cpu_count; i++)
+        if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+            CPU_SET(cpus[i], &cpu_set);
+
+    return sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+}
+
+/**
+ * @brief Print which CPU every TA was pinned to and which CPUs it started and finished marking on
+ *
+ * @param stats Pointer to the statistics block in shared memory, every TA recorded its CPUs in its own set
+ */
+void print_ta_placement(stats_block *stats)
+{
+    LOG_INFO(ANSI_COLOR_RED "\n------------TA PLACEMENT------------" ANSI_COLOR_RESET "\n");
+    for (int ta = 1; ta <= stats->ta_count; ta++)
+    {
+        latency_stats *set = &stats->sets[ta];
+        if (set->pinned_cpu >= 0)
+            LOG_INFO("TA %d was pinned to CPU %d (socket %d), it started on CPU %d and finished on CPU %d\n",
+                     ta, set->pinned_cpu, cpu_topology_id(set->pinned_cpu, "physical_package_id", 0), set->started_cpu, set->finished_cpu);
+        else
+            LOG_INFO("TA %d was not pinned, it started on CPU %d and finished on CPU %d\n", ta, set->started_cpu, set->finished_cpu);
+    }
+}
+
+/**
+ * @brief Pick which semaphore in the set guards a given exam
+ * Exams are spread over EXAM_LOCK_STRIPES semaphores by their index, so with enough stripes every exam has its own lock
+ *
+ * @param exam_index Index of the exam in the exam_files[] array
+ * @return int The semaphore number (stripe) to lock for that exam
+ */
+int exam_lock_stripe(int exam_index)
+{
+    return exam_index % EXAM_LOCK_STRIPES;
+}
+
+/**
+ * @brief Create the Shared Memory exam locks, one lock per stripe with the backend picked by --lock=
+ * With LOCK_BACKEND_SYSV every stripe is a semaphore of one SysV semaphore set, the other backends live entirely in the shared memory object
+ *
+ * @param backend One of the LOCK_BACKEND_ values
+ * @param num_ta_processes Number of TAs that may take the locks, every TA gets an MCS queue node
+ * @param semaphore_key Key of the SysV semaphore set, SEMAOPHORE_KEY for marking or IPC_PRIVATE for a set nobody else can find
+ * @return *exam_lock_set A pointer to the exam locks in shared memory
+ */
+exam_lock_set *createSharedMemExamLocks(int backend, int num_ta_processes, key_t semaphore_key)
+{
+    // remove name of the exam locks if they already exist, no error occurs if not
+    shm_unlink(SHARED_EXAM_LOCKS);
+
+    // create the shared memory exam locks
+    int shm_fd = shm_open(SHARED_EXAM_LOCKS, O_CREAT | O_RDWR, 0666);
+    if (shm_fd == -1)
+    {
+        fprintf(stderr, "Failed to create exam locks!\n");
+        return NULL;
+    }
+
+    // configure the size of the shared memory exam locks, every lock starts out unlocked since the object is zero filled
+    size_t locks_size = sizeof(exam_lock_set) + sizeof(mcs_node) * (size_t)num_ta_processes;
+    if (ftruncate(shm_fd, locks_size) == -1)
+    {
+        fprintf(stderr, "Failed to configure the size of exam locks!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    // map the shared memory exam locks into our memory space
+    exam_lock_set *locks = mmap(0, locks_size,
+                                PROT_READ | PROT_WRITE, MAP_SHARED,
+                                shm_fd, 0);
+    if (locks == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the shared memory exam locks!\n");
+        close(shm_fd);
+        return NULL;
+    }
+
+    close(shm_fd);
+    locks->backend = backend;
+    locks->ta_count = num_ta_processes;
+    locks->semaphore_id = -1;
+
+    if (backend == LOCK_BACKEND_ROBUST)
+    {
+        // the same kind of mutex as the rubric lock, the kernel hands it over if the TA holding it dies
+        pthread_mutexattr_t lock_attr;
+        pthread_mutexattr_init(&lock_attr);
+        pthread_mutexattr_setpshared(&lock_attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&lock_attr, PTHREAD_MUTEX_ROBUST);
+        for (int i = 0; i < EXAM_LOCK_STRIPES; i++)
+            pthread_mutex_init(&locks->stripes[i].robust_mutex, &lock_attr);
+        pthread_mutexattr_destroy(&lock_attr);
+    }
+    if (backend != LOCK_BACKEND_SYSV)
+        return locks;
+
+    // remove the semaphore set if it is left over from a previous run, it may have a different number of stripes
+    if (semaphore_key != IPC_PRIVATE)
+    {
+        int stale_semaphore_id = semget(semaphore_key, 0, 0666);
+        if (stale_semaphore_id != -1)
+            semctl(stale_semaphore_id, 0, IPC_RMID);
+    }
+
+    // Create a semaphore set with SEM_KEY (20254001) that contains one semaphore per exam lock stripe
+    locks->semaphore_id = semget(semaphore_key, EXAM_LOCK_STRIPES, IPC_CREAT | 0666);
+    if (locks->semaphore_id == -1)
+    {
+        fprintf(stderr, "Failed to create the semaphore set...\n");
+        // we don't have to exit, part 2a showed the code can work without semaphore's, just may run into race conditions
+        return locks;
+    }
+
+    // Initialize every semaphore stripe to 1 --> unlocked
+    unsigned short stripe_values[EXAM_LOCK_STRIPES];
+    for (int i = 0; i < EXAM_LOCK_STRIPES; i++)
+        stripe_values[i] = 1;
+
+    if (semctl(locks->semaphore_id, 0, SETALL, stripe_values) == -1)
+    {
+        fprintf(stderr, "Failed to initialize the semaphore (unlocked)...\n");
+        // we don't have to exit, part 2a showed the code can work without semaphore's, just may run into race conditions
+    }
+    return locks;
+}
+
+/**
+ * @brief Remove the exam locks once nobody uses them anymore, so the next run starts clean
+ *
+ * @param locks Pointer to the exam locks in shared memory
+ */
+void remove_exam_locks(exam_lock_set *locks)
+{
+    if (locks->semaphore_id != -1)
+        semctl(locks->semaphore_id, 0, IPC_RMID);
+    munmap(locks, sizeof(exam_lock_set) + sizeof(mcs_node) * (size_t)locks->ta_count);
+    shm_unlink(SHARED_EXAM_LOCKS);
+}
+
+/**
+ * @brief Get the name of a lock backend, as it is given to --lock=
+ *
+ * @param backend One of the LOCK_BACKEND_ values
+ * @return const char* Name of the backend
+ */
+const char *lock_backend_name(int backend)
+{
+    switch (backend)
+    {
+    case LOCK_BACKEND_SYSV:
+        return "sysv";
+    case LOCK_BACKEND_FUTEX:
+        return "futex";
+    case LOCK_BACKEND_TICKET:
+        return "ticket";
+    case LOCK_BACKEND_MCS:
+        return "mcs";
+    case LOCK_BACKEND_ROBUST:
+        return "robust";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Sleep in the kernel until the futex word is woken, unless it no longer holds the expected value
+ * The lock lives in a MAP_SHARED object, so this is a shared futex and not FUTEX_PRIVATE_FLAG.
+ * The sleep ends after LOCK_OWNER_CHECK_MILLISECONDS at the latest, so the caller can check whether the holder died
+ *
+ * @param word The futex word
+ * @param expected Value the word must still have for the caller to go to sleep
+ * @return int 1 if nobody woke us before the time ran out, 0 otherwise
+ */
+int futex_wait(atomic_uint *word, unsigned int expected)
+{
+    struct timespec timeout = {0, LOCK_OWNER_CHECK_MILLISECONDS * 1000000L};
+    return syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, NULL, 0) == -1 && errno == ETIMEDOUT;
+}
+
+/**
+ * @brief Wake processes sleeping on a futex word
+ *
+ * @param word The futex word
+ * @param count Most processes to wake
+ */
+void futex_wake(atomic_uint *word, int count)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+/**
+ * @brief Check whether a process is gone, to tell that the TA holding an exam lock died
+ * A TA that died but was not reaped by main() yet still exists, main() reaps it within SUPERVISOR_POLL_MICROSECONDS
+ *
+ * @param pid The process to check
+ * @return int 1 if there is no such process anymore, 0 otherwise
+ */
+int process_is_dead(pid_t pid)
+{
+    return kill(pid, 0) == -1 && errno == ESRCH;
+}
+
+/**
+ * @brief Wait a little while spinning on a lock, after LOCK_SPINS_BEFORE_YIELD tries give the CPU to another process
+ * There can be more TAs than CPUs, and the TA we wait for may be one of the ones that are not running
+ *
+ * @param spins Number of times the caller has spun so far, updated
+ */
+void lock_spin_wait(int *spins)
+{
+    if (++*spins < LOCK_SPINS_BEFORE_YIELD)
+        return;
+    *spins = 0;
+    sched_yield();
+}
+
+/**
+ * @brief Lock an exam lock stripe so only one TA can work in its critical section
+ * Which lock is taken depends on the backend the locks were created with:
+ * sysv decrements the stripe's semaphore with semop(), a system call every time,
+ * futex takes the lock with one compare-and-swap and only enters the kernel when it has to sleep,
+ * ticket hands the lock out in the order TAs asked for it,
+ * mcs queues every waiting TA on its own node so each one spins on its own cache line, and
+ * robust is a robust process-shared pthread mutex.
+ * If the TA holding the lock died, sysv, futex and robust hand the lock to the next TA with LOCK_OWNER_DIED so it can
+ * repair what the dead TA was writing. ticket and mcs can't tell, which is why parse_arguments() only allows them with TA threads.
+ * sysv retries when a signal interrupts semop(), any other error is reported and counted in locks->lock_failures
+ *
+ * @param locks Pointer to the exam locks in shared memory
+ * @param stripe The lock stripe within the set to lock
+ * @param ta_index 0 based index of the TA taking the lock, picks its MCS queue node
+ * @return int LOCK_ACQUIRED, LOCK_OWNER_DIED if the TA that held the lock died holding it, or LOCK_FAILED if the lock could not be taken
+ */
+int waitSemaphore(exam_lock_set *locks, int stripe, int ta_index)
+{
+    exam_lock *lock = &locks->stripes[stripe];
+    int spins = 0;
+
+    if (locks->backend == LOCK_BACKEND_FUTEX)
+    {
+        // the word holds the pid of the holder, so a TA waiting on it can tell when the holder died and take over
+        unsigned int own_pid = (unsigned int)getpid();
+        unsigned int state = 0;
+        if (atomic_compare_exchange_strong(&lock->futex_word, &state, own_pid))
+            return LOCK_ACQUIRED;
+        for (;;)
+        {
+            if (state == 0)
+            {
+                // keep FUTEX_WAITERS set, other TAs may still be sleeping on the word
+                if (atomic_compare_exchange_strong(&lock->futex_word, &state, own_pid | FUTEX_WAITERS))
+                    return LOCK_ACQUIRED;
+                continue;
+            }
+            if (!(state & FUTEX_WAITERS) && !atomic_compare_exchange_strong(&lock->futex_word, &state, state | FUTEX_WAITERS))
+                continue;
+
+            unsigned int holder = state | FUTEX_WAITERS;
+            int timed_out = futex_wait(&lock->futex_word, holder);
+            state = atomic_load(&lock->futex_word);
+            if (timed_out && state == holder && process_is_dead((pid_t)(holder & FUTEX_TID_MASK)) &&
+                atomic_compare_exchange_strong(&lock->futex_word, &state, own_pid | FUTEX_WAITERS))
+                return LOCK_OWNER_DIED;
+        }
+    }
+    else if (locks->backend == LOCK_BACKEND_TICKET)
+    {
+        unsigned int ticket = atomic_fetch_add(&lock->next_ticket, 1);
+        while (atomic_load_explicit(&lock->now_serving, memory_order_acquire) != ticket)
+            lock_spin_wait(&spins);
+    }
+    else if (locks->backend == LOCK_BACKEND_MCS)
+    {
+        // queue entries are TA index + 1, so 0 can mean nobody
+        mcs_node *own_node = &locks->mcs_nodes[ta_index];
+        atomic_store(&own_node->next, 0);
+        atomic_store(&own_node->locked, 1);
+
+        int predecessor = atomic_exchange(&lock->mcs_tail, ta_index + 1);
+        if (predecessor == 0)
+            return LOCK_ACQUIRED; // the queue was empty, the lock is ours
+
+        atomic_store(&locks->mcs_nodes[predecessor - 1].next, ta_index + 1);
+        while (atomic_load_explicit(&own_node->locked, memory_order_acquire))
+            lock_spin_wait(&spins);
+    }
+    else if (locks->backend == LOCK_BACKEND_ROBUST)
+    {
+        return lock_robust_mutex(&lock->robust_mutex);
+    }
+    else
+    {
+        // SEM_UNDO lets the kernel give the semaphore back if the TA holding it dies,
+        // the pid it leaves behind in owner_pid tells the next TA that it did
+        struct sembuf sem_op = {stripe, -1, SEM_UNDO};
+        int semop_result;
+        while ((semop_result = semop(locks->semaphore_id, &sem_op, 1)) == -1 && errno == EINTR)
+            ;
+        if (semop_result == -1)
+        {
+            // the set is gone or was never created, going on would mean writing the exam file unprotected
+            fprintf(stderr, "Failed to lock semaphore stripe %d: %s!\n", stripe, strerror(errno));
+            atomic_fetch_add(&locks->lock_failures, 1);
+            return LOCK_FAILED;
+        }
+        if (atomic_exchange(&lock->owner_pid, getpid()) != 0)
+            return LOCK_OWNER_DIED;
+    }
+    return LOCK_ACQUIRED;
+}
+
+/**
+ * @brief Unlock an exam lock stripe so that another TA can go work in the critical section
+ *
+ * @param locks Pointer to the exam locks in shared memory
+ * @param stripe The lock stripe within the set to unlock
+ * @param ta_index 0 based index of the TA giving the lock back, must be the one that took it
+ */
+void signalSemaphore(exam_lock_set *locks, int stripe, int ta_index)
+{
+    exam_lock *lock = &locks->stripes[stripe];
+    int spins = 0;
+
+    if (locks->backend == LOCK_BACKEND_FUTEX)
+    {
+        // only enter the kernel if somebody may be sleeping
+        if (atomic_exchange(&lock->futex_word, 0) & FUTEX_WAITERS)
+            futex_wake(&lock->futex_word, 1);
+    }
+    else if (locks->backend == LOCK_BACKEND_TICKET)
+    {
+        atomic_fetch_add_explicit(&lock->now_serving, 1, memory_order_release);
+    }
+    else if (locks->backend == LOCK_BACKEND_MCS)
+    {
+        mcs_node *own_node = &locks->mcs_nodes[ta_index];
+        int successor = atomic_load(&own_node->next);
+        if (successor == 0)
+        {
+            // nobody queued behind us, unless one is between swapping the tail and linking itself in
+            int expected = ta_index + 1;
+            if (atomic_compare_exchange_strong(&lock->mcs_tail, &expected, 0))
+                return;
+            while ((successor = atomic_load(&own_node->next)) == 0)
+                lock_spin_wait(&spins);
+        }
+        atomic_store_explicit(&locks->mcs_nodes[successor - 1].locked, 0, memory_order_release);
+    }
+    else if (locks->backend == LOCK_BACKEND_ROBUST)
+    {
+        pthread_mutex_unlock(&lock->robust_mutex);
+    }
+    else
+    {
+        atomic_store(&lock->owner_pid, 0);
+        struct sembuf sem_op = {stripe, 1, SEM_UNDO};
+        semop(locks->semaphore_id, &sem_op, 1);
+    }
+}
+
+/**
+ * @brief Measure one lock backend with a number of processes all fighting over one lock for LOCK_BENCH_MILLISECONDS
+ * Every process takes the lock, bumps a counter that is not atomic and lets it go again, as fast as it can.
+ * If the lock excludes properly the counter ends up equal to the number of times the lock was taken
+ *
+ * @param backend One of the LOCK_BACKEND_ values
+ * @param num_processes Number of processes taking the lock
+ * @param result Where to store what was measured
+ * @return int 0 on success, -1 if the locks or processes could not be created
+ */
+int run_lock_benchmark_once(int backend, int num_processes, lock_bench_result *result)
+{
+    // a private semaphore set, so a marking run going on at the same time keeps its own
+    exam_lock_set *locks = createSharedMemExamLocks(backend, num_processes, IPC_PRIVATE);
+    if (locks == NULL)
+        return -1;
+
+    size_t shared_size = sizeof(lock_bench_shared) + sizeof(lock_bench_counter) * (size_t)num_processes;
+    lock_bench_shared *shared = mmap(0, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the lock benchmark counters!\n");
+        remove_exam_locks(locks);
+        return -1;
+    }
+
+    pid_t *pids = malloc(sizeof(pid_t) * num_processes);
+    if (pids == NULL)
+    {
+        printf("Could not allocate memory for array to store lock benchmark PID's!\n");
+        exit(1);
+    }
+
+    for (int p = 0; p < num_processes; p++)
+    {
+        pids[p] = fork();
+        if (pids[p] == -1)
+        {
+            printf("Lock benchmark process #%d could not be created!\n", p + 1);
+            // let the processes already created run straight into the stop flag and reap them
+            atomic_store(&shared->stop, 1);
+            atomic_store(&shared->start, 1);
+            for (int q = 0; q < p; q++)
+                waitpid(pids[q], NULL, 0);
+            free(pids);
+            munmap(shared, shared_size);
+            remove_exam_locks(locks);
+            return -1;
+        }
+        if (pids[p] == 0)
+        {
+            atomic_fetch_add(&shared->ready, 1);
+            while (!atomic_load(&shared->start))
+                sched_yield();
+
+            long long acquisitions = 0;
+            while (!atomic_load_explicit(&shared->stop, memory_order_relaxed))
+            {
+                if (waitSemaphore(locks, 0, p) == LOCK_FAILED)
+                    break; // already reported, the run still gets this process's count
+                shared->protected_counter++;
+                signalSemaphore(locks, 0, p);
+                acquisitions++;
+            }
+            shared->counters[p].acquisitions = acquisitions;
+            exit(0);
+        }
+    }
+
+    // only start the clock once every process is waiting at the start line, forking many of them takes a while
+    while (atomic_load(&shared->ready) < num_processes)
+        sched_yield();
+    unsigned long long started = now_nanoseconds();
+    atomic_store(&shared->start, 1);
+    usleep(LOCK_BENCH_MILLISECONDS * 1000);
+    atomic_store(&shared->stop, 1);
+    unsigned long long stopped = now_nanoseconds();
+    for (int p = 0; p < num_processes; p++)
+        waitpid(pids[p], NULL, 0);
+    free(pids);
+
+    // Jain's fairness index, 1 when every process got the lock equally often and 1/n when one process got it every time
+    long long total = 0;
+    double sum_of_squares = 0;
+    result->min_acquisitions = -1;
+    result->max_acquisitions = 0;
+    for (int p = 0; p < num_processes; p++)
+    {
+        long long acquisitions = shared->counters[p].acquisitions;
+        total += acquisitions;
+        sum_of_squares += (double)acquisitions * (double)acquisitions;
+        if (result->min_acquisitions == -1 || acquisitions < result->min_acquisitions)
+            result->min_acquisitions = acquisitions;
+        if (acquisitions > result->max_acquisitions)
+            result->max_acquisitions = acquisitions;
+    }
+
+    result->backend = backend;
+    result->process_count = num_processes;
+    result->seconds = (stopped - started) / 1e9;
+    result->acquisitions = total;
+    result->fairness = sum_of_squares > 0 ? (double)total * (double)total / (num_processes * sum_of_squares) : 0;
+    result->exclusive = shared->protected_counter == total;
+
+    munmap(shared, shared_size);
+    remove_exam_locks(locks);
+    return 0;
+}
+
+/**
+ * @brief Compare the throughput and fairness of every lock backend with 2, 4, 8, ... up to options->lock_bench_max_tas processes
+ *
+ * @param options The options the marker was started with
+ * @return int 0 on success, -1 if any run could not be set up
+ */
+int run_lock_benchmark(const marker_options *options)
+{
+    if (options->bench_format == BENCH_FORMAT_CSV)
+        printf("backend,processes,seconds,acquisitions,acquisitions_per_second,fairness,min_acquisitions,max_acquisitions,exclusive\n");
+
+    for (int backend = 0; backend < LOCK_BACKEND_COUNT; backend++)
+    {
+        for (int num_processes = 2; num_processes <= options->lock_bench_max_tas; num_processes *= 2)
+        {
+            lock_bench_result result;
+            if (run_lock_benchmark_once(backend, num_processes, &result) == -1)
+                return -1;
+
+            double per_second = result.seconds > 0 ? result.acquisitions / result.seconds : 0;
+            if (options->bench_format == BENCH_FORMAT_JSON)
+                printf("{\"backend\":\"%s\",\"processes\":%d,\"seconds\":%.6f,\"acquisitions\":%lld,\"acquisitions_per_second\":%.1f,"
+                       "\"fairness\":%.4f,\"min_acquisitions\":%lld,\"max_acquisitions\":%lld,\"exclusive\":%s}\n",
+                       lock_backend_name(backend), num_processes, result.seconds, result.acquisitions, per_second,
+                       result.fairness, result.min_acquisitions, result.max_acquisitions, result.exclusive ? "true" : "false");
+            else
+                printf("%s,%d,%.6f,%lld,%.1f,%.4f,%lld,%lld,%d\n",
+                       lock_backend_name(backend), num_processes, result.seconds, result.acquisitions, per_second,
+                       result.fairness, result.min_acquisitions, result.max_acquisitions, result.exclusive);
+        }
+    }
+    return 0;
 }
 
 /**
- * @brief Get an array of exam file names that are contained in the exams/ directory
- * ex. [exam1, exam2, exam3, etc.]...
- *
- * The idea is that if we want to increase or decrease number of exam files in exams/ dir
- * We can do so without worrying about breaking the rest of the code
+ * @brief Generate a fresh pile of exams and run the marker on it once as a benchmark run, then measure it
+ * The run happens in a child process in its own process group, so nothing the run leaves running can outlive it.
+ * Everything the run prints is thrown away, what it measured is read back from the exam store and the statistics block once it exits
  *
- * @param exam_count The number of files within the exams/ directory
- * @return char** The array of exam file names
+ * @param options The benchmark options, the run marks the exam store with time scale 0 and BENCH_SEED
+ * @param exam_count Number of exams in the pile
+ * @param ta_count Number of TAs in this run
+ * @param result Where to store what the run measured
+ * @return int 0 on success, -1 if the run could not be started or measured
  */
-char **list_exams(int *exam_count)
+int run_benchmark_once(const marker_options *options, int exam_count, int ta_count, bench_result *result)
 {
-    // open directoru stream from exams/ directory
-    struct dirent *de;
-    DIR *dr = opendir("exams/");
-
-    int exam_file_count = 0;
+    marker_options run_options = *options;
+    run_options.number_of_tas = ta_count;
+    run_options.exam_io_mode = EXAM_IO_STORE;
+    run_options.time_scale = 0;
+    run_options.virtual_time = 0;
+    run_options.seed = BENCH_SEED;
+    run_options.bench_max_tas = 0;
 
-    if (dr == NULL)
+    unsigned long long run_started = now_nanoseconds();
+    pid_t pid = fork();
+    if (pid == -1)
     {
-        printf("Could not open current directory");
-        exit(1);
+        printf("Benchmark run could not be created!\n");
+        return -1;
     }
-
-    // count how many files are in the directory while ignoring '.' and '..'
-    // I don't even know what they are but when I printed the directory array in a previous iteraction, those were in there,
-    // so now we were getting rid of them, so the directory array only contains exam files
-    while ((de = readdir(dr)) != NULL)
+    if (pid == 0)
     {
-        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
-            continue;
-
-        exam_file_count++;
+        setpgid(0, 0);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd != -1)
+        {
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+        if (generate_exam_store(exam_count, options->questions_to_mark, options->sentinel_at) == -1)
+            exit(1);
+        exit(run_marking(&run_options));
     }
+    setpgid(pid, pid); // also from this side, so the process group exists before we could ever signal it
 
-    // reset directory stream to pass loop a second time to write filenames to array after counting how many files we have
-    rewinddir(dr);
-
-    // allocate memory for the array based off the total file count in the directory
-    char **exam_files = malloc(sizeof(char *) * exam_file_count);
-    if (exam_files == NULL)
+    int status;
+    waitpid(pid, &status, 0);
+    unsigned long long run_finished = now_nanoseconds();
+    kill(-pid, SIGKILL); // if the run failed, make sure none of its TAs outlive it
+    if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
     {
-        closedir(dr);
-        return NULL;
+        fprintf(stderr, "Benchmark run with %d TAs failed!\n", ta_count);
+        return -1;
     }
 
-    int i = 0;
+    memset(result, 0, sizeof(*result));
+    result->ta_count = ta_count;
+    result->questions_to_mark = options->questions_to_mark;
 
-    // read every single final name in the exams/ directory
-    // remove the extension, i.e., .txt
-    // allocate memory into the array for the filename
-    // store the filename into the array, i.e., "exam1", "exam2", etc.
-    while ((de = readdir(dr)) != NULL)
+    // marks and fully marked exams are counted in the store itself, questions that started out marked don't count
+    size_t store_size;
+    exam_store *store = map_exam_store(&store_size);
+    if (store == NULL)
+        return -1;
+    result->exam_count = store->exam_count;
+    for (int i = 0; i < store->exam_count; i++)
     {
-        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
-            continue;
-
-        char *exam_name = de->d_name;
-        size_t len = strlen(exam_name);
+        unsigned int status_bits = atomic_load(&store->records[i].question_status);
+        result->marks += __builtin_popcount(status_bits) - (QUESTIONS_PER_EXAM - options->questions_to_mark);
+        result->exams_marked += status_bits == ALL_QUESTIONS_MASK;
+    }
+    munmap(store, store_size);
 
-        // remove the .txt extension
-        if (len > 4 && strcmp(exam_name + len - 4, ".txt") == 0)
+    // the run left its shutdown state behind too, it tells whether a sentinel cut the pile off
+    int shutdown_fd = shm_open(SHARED_SHUTDOWN, O_RDONLY, 0666);
+    if (shutdown_fd != -1)
+    {
+        shutdown_state *shutdown = mmap(0, sizeof(shutdown_state), PROT_READ, MAP_SHARED, shutdown_fd, 0);
+        close(shutdown_fd);
+        if (shutdown != MAP_FAILED)
         {
-            len -= 4;
+            result->stopped_by_sentinel = shutdown->sentinel_exam != -1;
+            munmap(shutdown, sizeof(shutdown_state));
         }
+    }
+
+    // the run left its statistics block behind, the next run unlinks it before creating its own
+    int shm_fd = shm_open(SHARED_STATS, O_RDONLY, 0666);
+    if (shm_fd == -1)
+    {
+        fprintf(stderr, "Failed to open the statistics block of the benchmark run!\n");
+        return -1;
+    }
+    size_t stats_size = sizeof(stats_block) + sizeof(latency_stats) * (size_t)(ta_count + 1);
+    stats_block *stats = mmap(0, stats_size, PROT_READ, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if (stats == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the statistics block of the benchmark run!\n");
+        return -1;
+    }
 
-        // allocate memory to store filename in array
-        exam_files[i] = malloc(len + 1);
-        if (exam_files[i] == NULL)
+    // the run finished when its last TA ran out of work or stopped at the sentinel, a TA that died never records it and the time the run was reaped is close enough
+    unsigned long long started = stats->marking_started_ns != 0 ? stats->marking_started_ns : run_started;
+    unsigned long long finished = 0;
+    for (int set = 1; set <= ta_count; set++)
+    {
+        if (stats->sets[set].finished_ns == 0)
         {
-            return NULL;
+            finished = run_finished;
+            break;
         }
-
-        // store (copy) filename with .txt into array
-        strncpy(exam_files[i], exam_name, len);
-        exam_files[i][len] = '\0';
-        i++;
+        if (stats->sets[set].finished_ns > finished)
+            finished = stats->sets[set].finished_ns;
     }
+    result->seconds = (finished - started) / 1e9;
 
-    closedir(dr);                  // close the directory stream
-    *exam_count = exam_file_count; // store the number of total exam files
-    return exam_files;
+    latency_stats merged;
+    merge_latency_stats(stats, &merged);
+    munmap(stats, stats_size);
+
+    // the benchmark always marks with --exam-io=store, which claims questions without the exam locks, so only the rubric lock is ever waited for
+    double lock_wait_ns = (double)merged.metrics[STAT_RUBRIC_LOCK_WAIT].total_ns;
+    if (finished > started)
+        result->rubric_lock_wait_share = lock_wait_ns / ((double)(finished - started) * ta_count);
+    return 0;
 }
 
 /**
- * @brief Helper function to remove specific element from an array
- * This will be used to remove an already marked question from the array of all question number
+ * @brief Print one line of the benchmark report
  *
- * @param arr Array to remove an element from
- * @param size Size of the array
- * @param index Index of the element to remove
- * @return int Returns the size of the new array
+ * @param result What the run measured
+ * @param baseline_seconds How long the same pile took with one TA, for the speedup and parallel efficiency
+ * @param bench_format BENCH_FORMAT_CSV or BENCH_FORMAT_JSON
  */
-int remove_by_index(int arr[], int size, int index)
+void print_bench_result(const bench_result *result, double baseline_seconds, int bench_format)
 {
-    if (index < 0 || index >= size)
-        return size;
+    double exams_per_second = result->seconds > 0 ? result->exams_marked / result->seconds : 0;
+    double marks_per_second = result->seconds > 0 ? result->marks / result->seconds : 0;
+    double speedup = result->seconds > 0 ? baseline_seconds / result->seconds : 0;
+    double efficiency = speedup / result->ta_count;
 
-    for (int i = index; i < size - 1; i++)
-        arr[i] = arr[i + 1];
+    if (bench_format == BENCH_FORMAT_JSON)
+    {
+        printf("{\"exams\":%d,\"questions\":%d,\"tas\":%d,\"seconds\":%.6f,\"exams_marked\":%d,\"marks\":%lld,"
+               "\"exams_per_second\":%.1f,\"marks_per_second\":%.1f,\"speedup\":%.3f,\"efficiency\":%.3f,"
+               "\"rubric_lock_wait_share\":%.4f,\"stopped_by_sentinel\":%s}\n",
+               result->exam_count, result->questions_to_mark, result->ta_count, result->seconds, result->exams_marked, result->marks,
+               exams_per_second, marks_per_second, speedup, efficiency,
+               result->rubric_lock_wait_share, result->stopped_by_sentinel ? "true" : "false");
+        return;
+    }
 
-    return size - 1;
+    printf("%d,%d,%d,%.6f,%d,%lld,%.1f,%.1f,%.3f,%.3f,%.4f,%d\n",
+           result->exam_count, result->questions_to_mark, result->ta_count, result->seconds, result->exams_marked, result->marks,
+           exams_per_second, marks_per_second, speedup, efficiency,
+           result->rubric_lock_wait_share, result->stopped_by_sentinel);
 }
 
 /**
- * @brief Create a TA Process to run concurrently with other TA proccesses to mark questions on exams
+ * @brief Copy a whole file, however large, so it can be renamed back over the original later
  *
- * @param num_ta_processes Number of TA processes to create based on supplied command line args in main()
- * @param rubric Pointer to the rubric in shared memory to grade from
- * @param exam Pointer to the exam in shared memory to grade
- * @param exam_count Number of exams that need to be graded, depends on amount of exam files in exams/
- * @param exam_files Array of all the exam files in exams/
- * @param semaphore_id The ID (int) of the semaphore to be used for accessing critical sections of memory
- * @return pid_t* Return an array containing the pid's of all TA processes
+ * @param from Path of the file to copy
+ * @param to Path of the copy, replaced if it exists
+ * @return int 0 on success, -1 if either file could not be opened, read or written
  */
-pid_t *create_ta_processes(int num_ta_processes,
-                           rubric_shared_data *rubric,
-                           exam_file_shared_data *exam,
-                           int exam_count,
-                           char **exam_files,
-                           int semaphore_id)
+int copy_file(const char *from, const char *to)
 {
-
-    printf(ANSI_COLOR_RED "\n------------CREATING TA'S------------" ANSI_COLOR_RESET "\n");
-
-    // allocate memory to array of TA process ID's so we can wait for them in main
-    pid_t *ta_pids = malloc(sizeof(pid_t) * num_ta_processes);
-    if (ta_pids == NULL)
+    FILE *in = fopen(from, "rb");
+    if (in == NULL)
+        return -1;
+    FILE *out = fopen(to, "wb");
+    if (out == NULL)
     {
-        printf("Could not allocate memory for array to store TA PID's!\n");
-        exit(1);
+        fclose(in);
+        return -1;
     }
 
-    // loop for the amount of ta processes the user specified from the command line arg
-    for (int i = 0; i < num_ta_processes; i++)
+    char buffer[8192];
+    size_t length;
+    int result = 0;
+    while ((length = fread(buffer, 1, sizeof(buffer), in)) > 0)
     {
-        printf("Creating TA #%d now!\n", i + 1);
-        pid_t pid = fork(); // create the TA process as a CHILD process
-
-        // error in creating the TA process, exit with error
-        if (pid == -1)
+        if (fwrite(buffer, 1, length, out) != length)
         {
-            printf("TA Process #%d could not be created!\n", i + 1);
-            free(ta_pids); // we can free the array of TA process PID's since we got an error when creating the TA process
-            exit(1);
+            result = -1;
+            break;
         }
-        // success in creating the TA process
-        else if (pid == 0)
-        {
-            sleep(1); // sleep a little bit to prevent the printout being laggy
-            printf(" --- TA Process #%d created - PID is %d --- \n", i + 1, getpid());
-            // ------ access the rubric stored in shared memory and correct it according to assignment specification ------
-            rubric = accessSharedMemRubric();
-            if (rubric == (rubric_shared_data *)-1)
-                exit(1);
-
-            waitSemaphore(semaphore_id); // lock semaphore for the specific process
-            printf(ANSI_COLOR_RED "\n------------TA #%d (PID: %d) LOCKING SEMAPHORE (%d) FOR RUBRIC CORRECTING------------" ANSI_COLOR_RESET "\n", i + 1, getpid(), semaphore_id);
-            check_and_correct_rubric(rubric, i + 1);
-            printf(ANSI_COLOR_RED "\n------------TA #%d (PID: %d) UNLOCKING SEMAPHORE (%d) FROM RUBRIC CORRECTING------------" ANSI_COLOR_RESET "\n", i + 1, getpid(), semaphore_id);
-            signalSemaphore(semaphore_id); // unlock semaphore from the specific process
-
-            srand(getpid()); // seed the rand() function for future use in the TA process
-
-            // run this loop for however many exams need to be marked, which is passed to create_ta_processes() as a param from main()
-            for (int j = exam_count - 1; j >= 0; j--)
-            {
-                // extract the first exam name from the exam_files[] array which holds all exam file names
-                // gotten directly from the exams/ directory
-                char *exam_file_name = exam_files[j];
-
-                waitSemaphore(semaphore_id); // lock semaphore for the specific process
-                printf(ANSI_COLOR_RED "\n------------TA #%d (PID: %d) LOCKING SEMAPHORE (%d) FOR EXAM LOADING------------" ANSI_COLOR_RESET "\n", i + 1, getpid(), semaphore_id);
-                // load the first exam's data into shared memory, exit with error if unable to
-                if (!load_exam(exam, exam_file_name, i + 1))
-                {
-                    fprintf(stderr, "Failed to load exam %s!\n", exam_file_name);
-                    exit(1);
-                }
-                printf(ANSI_COLOR_RED "\n------------TA #%d (PID: %d) UNLOCKING SEMAPHORE (%d) FROM EXAM MARKING------------" ANSI_COLOR_RESET "\n", i + 1, getpid(), semaphore_id);
-                signalSemaphore(semaphore_id); // unlock semaphore from the specific process
-
-                // run this loop until every single question is marked in the exam
-                while (exam_fully_marked(exam, exam_file_name) != 1)
-                {
-                    // array of question numbers, used later on to ensure the same question isn't "randomly" selected to be marked again
-                    int question_number_arr[] = {0, 1, 2, 3, 4};
-                    int length_question_number_arr =
-                        sizeof(question_number_arr) / sizeof(question_number_arr[0]);
-
-                    int exam_q_to_mark = rand() % length_question_number_arr; // randomly choose the index of the question_number_arr[], i.e., the next question to mark
-
-                    // first ensure the question is not already marked, then mark it
-                    if (!is_exam_q_marked(exam, question_number_arr[exam_q_to_mark]))
-                    {
-                        waitSemaphore(semaphore_id); // lock semaphore for the specific process
-                        printf(ANSI_COLOR_RED "\n------------TA #%d (PID: %d) LOCKING SEMAPHORE (%d) FOR EXAM MARKING------------" ANSI_COLOR_RESET "\n", i + 1, getpid(), semaphore_id);
-
-                        printf(ANSI_COLOR_RED "\n------------CORRECTING EXAM QUESTION------------" ANSI_COLOR_RESET "\n");
-
-                        // program may exit from mark_question if student number on exam is 9999
-                        mark_question(exam, question_number_arr[exam_q_to_mark]);
-
-                        // write the updated question status as marked to the actual exam .txt file in exams/
-                        correct_hardcopy_exam(exam, exam_file_name, question_number_arr[exam_q_to_mark]);
+    }
+    if (ferror(in))
+        result = -1;
+    fclose(in);
+    if (fclose(out) != 0)
+        result = -1;
+    if (result == -1)
+        unlink(to);
+    return result;
+}
 
-                        printf("TA #%d marked question %d on exam %s for student %04d\n",
-                               i + 1,
-                               question_number_arr[exam_q_to_mark] + 1,
-                               exam_file_name,
-                               exam->student_number);
+/**
+ * @brief Benchmark how marking scales, for every pile size in options->bench_exam_counts run 1 to options->bench_max_tas TAs
+ * Every run gets a freshly generated pile in the exam store and runs with the delays off, so it measures the marker itself.
+ * The one TA run of each pile is the baseline for speedup and parallel efficiency. rubric.txt and exams.bin are put back the way they were afterwards
+ *
+ * @param options The options the marker was started with
+ * @return int 0 on success, -1 if any run could not be set up or measured
+ */
+int run_benchmark(const marker_options *options)
+{
+    // every run corrects the rubric, keep a copy of the original to rename back once we are done
+    if (copy_file(RUBRIC_FILE, RUBRIC_FILE_BACKUP) == -1)
+    {
+        fprintf(stderr, "Could not back up %s to %s!\n", RUBRIC_FILE, RUBRIC_FILE_BACKUP);
+        return -1;
+    }
 
-                        printf(ANSI_COLOR_RED "\n------------MARKING EXAM QUESTION CORRECT ON EXAM FILE------------" ANSI_COLOR_RESET "\n");
+    // every run generates its own exam store, move the user's out of the way (there may be none)
+    int had_exam_store = rename(EXAM_STORE, EXAM_STORE_BACKUP) == 0;
+    if (!had_exam_store && errno != ENOENT)
+    {
+        fprintf(stderr, "Could not back up %s to %s!\n", EXAM_STORE, EXAM_STORE_BACKUP);
+        unlink(RUBRIC_FILE_BACKUP);
+        return -1;
+    }
 
-                        printf("TA #%d modified question %d on exam %s for student %04d as marked!\n",
-                               i + 1,
-                               question_number_arr[exam_q_to_mark] + 1,
-                               exam_file_name,
-                               exam->student_number);
+    if (options->bench_format == BENCH_FORMAT_CSV)
+        printf("exams,questions,tas,seconds,exams_marked,marks,exams_per_second,marks_per_second,speedup,efficiency,rubric_lock_wait_share,stopped_by_sentinel\n");
 
-                        printf(ANSI_COLOR_RED "\n------------TA #%d (PID: %d) UNLOCKING SEMAPHORE (%d) FROM EXAM MARKING------------" ANSI_COLOR_RESET "\n", i + 1, getpid(), semaphore_id);
-                        signalSemaphore(semaphore_id); // unlock semaphore from the specific process
-                    }
-                    // this is if the question is already marked, we remove that questions number from the question_number_arr[] array
-                    // so it cannot be chosen in a future iteration for marking by this TA process
-                    else
-                    {
-                        length_question_number_arr =
-                            remove_by_index(question_number_arr,
-                                            length_question_number_arr,
-                                            exam_q_to_mark);
-
-                        // if the length of the length_question_number_arr[] is 0, that means that every single question number has been removed,
-                        // i.e., every single question has been marked, we can break from the while()
-                        if (length_question_number_arr == 0)
-                            break;
-                    }
-                }
-                shm_unlink(exam_file_name); // remove name of shared memory object
-            }
-            // When every single exam in exam_files[] has been processed by this TA, we can exit this TA process
-            exit(0);
-        }
-        else
+    int result = 0;
+    for (int p = 0; p < options->bench_pile_count && result == 0; p++)
+    {
+        double baseline_seconds = 0;
+        for (int ta_count = 1; ta_count <= options->bench_max_tas; ta_count++)
         {
-            ta_pids[i] = pid; // ensure the TA process PID get's addedd to the ta_pids array
+            bench_result run;
+            if (run_benchmark_once(options, options->bench_exam_counts[p], ta_count, &run) == -1)
+            {
+                result = -1;
+                break;
+            }
+            if (ta_count == 1)
+                baseline_seconds = run.seconds;
+            print_bench_result(&run, baseline_seconds, options->bench_format);
         }
     }
-    return ta_pids;
-}
 
-/**
- * @brief Decrement semaphore counter so only one process can work in critical section
- *
- * @param semaphoreID The ID of the semaphore we want to use
- */
-void waitSemaphore(int semaphoreID)
-{
-    struct sembuf sem_op = {0, -1, 0};
-    semop(semaphoreID, &sem_op, 1);
+    if (rename(RUBRIC_FILE_BACKUP, RUBRIC_FILE) == -1)
+    {
+        fprintf(stderr, "Could not restore %s, the original is still in %s!\n", RUBRIC_FILE, RUBRIC_FILE_BACKUP);
+        result = -1;
+    }
+    if (had_exam_store ? rename(EXAM_STORE_BACKUP, EXAM_STORE) == -1 : unlink(EXAM_STORE) == -1 && errno != ENOENT)
+    {
+        fprintf(stderr, had_exam_store ? "Could not restore %s, the original is still in %s!\n" : "Could not remove the benchmark's %s!\n", EXAM_STORE, EXAM_STORE_BACKUP);
+        result = -1;
+    }
+    return result;
 }
 
 /**
- * @brief Increment semaphore counter so that another process can go work in the critical section
+ * @brief Read the command line arguments into the marker options
+ * ./main [number of TAs] [--threads] [--lock=sysv|futex|ticket|mcs|robust] [--pin=compact|scatter|<cpu>,<cpu>...] [--exam-io=journal|rewrite|mmap|store] [--msync] [--checkpoint-ms=<ms>] [--rubric-flush-ms=<ms>] [--time-scale=<factor>] [--virtual-time] [--seed=<n>] [--log-format=text|json]
+ * ./main --import-exams | --export-exams
+ * ./main --generate-exams=<count> [--questions=<n>] [--sentinel-at=<index>]
+ * ./main --lock-bench=<max TAs> [--bench-format=csv|json]
+ * ./main --bench=<max TAs> [--bench-exams=<count>[,<count>...]] [--bench-format=csv|json] [--questions=<n>] [--sentinel-at=<index>]
+ * The number of TAs keeps its old meaning, it defaults to 2 and cannot be less than 2
+ * --lock=ticket and --lock=mcs are refused for marking with TA processes, they would stall on a TA that died holding them
  *
- * @param semaphoreID The ID of the semaphore we want to use
+ * @param argc Argument count from main()
+ * @param argv Argument vector from main()
+ * @param options Where to store the parsed options
+ * @return int 0 on success, -1 if an argument was not understood or the options don't go together
  */
-void signalSemaphore(int semaphoreID)
+int parse_arguments(int argc, char *argv[], marker_options *options)
 {
-    struct sembuf sem_op = {0, 1, 0};
-    semop(semaphoreID, &sem_op, 1);
-}
+    options->number_of_tas = 0;
+    options->exam_io_mode = EXAM_IO_JOURNAL;
+    options->checkpoint_ms = DEFAULT_CHECKPOINT_MS;
+    options->rubric_flush_ms = DEFAULT_RUBRIC_FLUSH_MS;
+    options->msync_marks = 0;
+    options->store_command = STORE_COMMAND_NONE;
+    options->time_scale = 1.0;
+    options->virtual_time = 0;
+    options->log_format = LOG_FORMAT_TEXT;
+    options->seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32); // a different run every time unless --seed is given
+    options->generate_exam_count = 0;
+    options->questions_to_mark = QUESTIONS_PER_EXAM;
+    options->sentinel_at = -1;
+    options->bench_max_tas = 0;
+    options->bench_pile_count = 0;
+    options->bench_format = BENCH_FORMAT_CSV;
+    options->ta_mode = TA_MODE_PROCESSES;
+    options->pin_policy = PIN_NONE;
+    options->pin_cpu_count = 0;
+    options->lock_backend = LOCK_BACKEND_SYSV;
+    options->lock_bench_max_tas = 0;
 
-int main(int argc, char *argv[])
-{
-    setbuf(stdout, NULL); // print right away so nothing lags behind when checking printouts
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+
+        if (strcmp(arg, "--threads") == 0)
+            options->ta_mode = TA_MODE_THREADS;
+        else if (strcmp(arg, "--lock=sysv") == 0)
+            options->lock_backend = LOCK_BACKEND_SYSV;
+        else if (strcmp(arg, "--lock=futex") == 0)
+            options->lock_backend = LOCK_BACKEND_FUTEX;
+        else if (strcmp(arg, "--lock=ticket") == 0)
+            options->lock_backend = LOCK_BACKEND_TICKET;
+        else if (strcmp(arg, "--lock=mcs") == 0)
+            options->lock_backend = LOCK_BACKEND_MCS;
+        else if (strcmp(arg, "--lock=robust") == 0)
+            options->lock_backend = LOCK_BACKEND_ROBUST;
+        else if (strncmp(arg, "--lock-bench=", 13) == 0 && atoi(arg + 13) >= 2)
+            options->lock_bench_max_tas = atoi(arg + 13);
+        else if (strcmp(arg, "--pin=compact") == 0)
+            options->pin_policy = PIN_COMPACT;
+        else if (strcmp(arg, "--pin=scatter") == 0)
+            options->pin_policy = PIN_SCATTER;
+        else if (strncmp(arg, "--pin=", 6) == 0)
+        {
+            // a comma separated list of CPUs, TA n is pinned to the n-th one
+            const char *next = arg + 6;
+            options->pin_policy = PIN_LIST;
+            options->pin_cpu_count = 0;
+            while (*next != '\0' && options->pin_cpu_count < PIN_MAX_CPUS)
+            {
+                char *end;
+                long cpu = strtol(next, &end, 10);
+                if (end == next || cpu < 0 || cpu >= CPU_SETSIZE)
+                    break;
+                options->pin_cpus[options->pin_cpu_count++] = (int)cpu;
+                next = *end == ',' ? end + 1 : end;
+            }
+            if (*next != '\0' || options->pin_cpu_count == 0)
+            {
+                fprintf(stderr, "--pin= takes compact, scatter or up to %d CPU numbers separated by commas!\n", PIN_MAX_CPUS);
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--exam-io=journal") == 0)
+            options->exam_io_mode = EXAM_IO_JOURNAL;
+        else if (strcmp(arg, "--exam-io=rewrite") == 0)
+            options->exam_io_mode = EXAM_IO_REWRITE;
+        else if (strcmp(arg, "--exam-io=mmap") == 0)
+            options->exam_io_mode = EXAM_IO_MMAP;
+        else if (strcmp(arg, "--exam-io=store") == 0)
+            options->exam_io_mode = EXAM_IO_STORE;
+        else if (strcmp(arg, "--import-exams") == 0)
+            options->store_command = STORE_COMMAND_IMPORT;
+        else if (strcmp(arg, "--export-exams") == 0)
+            options->store_command = STORE_COMMAND_EXPORT;
+        else if (strncmp(arg, "--generate-exams=", 17) == 0 && atoi(arg + 17) > 0)
+        {
+            options->store_command = STORE_COMMAND_GENERATE;
+            options->generate_exam_count = atoi(arg + 17);
+        }
+        else if (strncmp(arg, "--questions=", 12) == 0 && atoi(arg + 12) >= 1 && atoi(arg + 12) <= QUESTIONS_PER_EXAM)
+            options->questions_to_mark = atoi(arg + 12);
+        else if (strncmp(arg, "--sentinel-at=", 14) == 0 && atoi(arg + 14) >= 0)
+            options->sentinel_at = atoi(arg + 14);
+        else if (strncmp(arg, "--bench=", 8) == 0 && atoi(arg + 8) > 0)
+            options->bench_max_tas = atoi(arg + 8);
+        else if (strncmp(arg, "--bench-exams=", 14) == 0)
+        {
+            // a comma separated list of pile sizes
+            const char *next = arg + 14;
+            options->bench_pile_count = 0;
+            while (*next != '\0' && options->bench_pile_count < BENCH_MAX_PILES)
+            {
+                char *end;
+                long exam_count = strtol(next, &end, 10);
+                if (end == next || exam_count <= 0 || exam_count > INT_MAX)
+                    break;
+                options->bench_exam_counts[options->bench_pile_count++] = (int)exam_count;
+                next = *end == ',' ? end + 1 : end;
+            }
+            if (*next != '\0' || options->bench_pile_count == 0)
+            {
+                fprintf(stderr, "--bench-exams= takes up to %d positive exam counts separated by commas!\n", BENCH_MAX_PILES);
+                return -1;
+            }
+        }
+        else if (strcmp(arg, "--bench-format=csv") == 0)
+            options->bench_format = BENCH_FORMAT_CSV;
+        else if (strcmp(arg, "--bench-format=json") == 0)
+            options->bench_format = BENCH_FORMAT_JSON;
+        else if (strncmp(arg, "--time-scale=", 13) == 0 && strtod(arg + 13, NULL) >= 0)
+            options->time_scale = strtod(arg + 13, NULL);
+        else if (strncmp(arg, "--seed=", 7) == 0)
+        {
+            // strtoull() would quietly take "-1" or "12abc", a seed that was mistyped must not give a different run than asked for
+            char *end;
+            errno = 0;
+            unsigned long long seed = strtoull(arg + 7, &end, 10);
+            if (end == arg + 7 || *end != '\0' || arg[7] == '-' || errno == ERANGE)
+            {
+                fprintf(stderr, "--seed= takes a whole number from 0 to %llu!\n", ULLONG_MAX);
+                return -1;
+            }
+            options->seed = seed;
+        }
+        else if (strcmp(arg, "--log-format=text") == 0)
+            options->log_format = LOG_FORMAT_TEXT;
+        else if (strcmp(arg, "--log-format=json") == 0)
+            options->log_format = LOG_FORMAT_JSON;
+        else if (strcmp(arg, "--virtual-time") == 0)
+            options->virtual_time = 1;
+        else if (strcmp(arg, "--msync") == 0)
+            options->msync_marks = 1;
+        else if (strncmp(arg, "--checkpoint-ms=", 16) == 0 && atoi(arg + 16) > 0)
+            options->checkpoint_ms = atoi(arg + 16);
+        else if (strncmp(arg, "--rubric-flush-ms=", 18) == 0 && atoi(arg + 18) > 0)
+            options->rubric_flush_ms = atoi(arg + 18);
+        else if (arg[0] != '-' && options->number_of_tas == 0)
+        {
+            options->number_of_tas = atoi(arg);
+            if (options->number_of_tas < 2)
+            {
+                printf("Must have at least two TA's!\n. Defaulting to 2...\n");
+                options->number_of_tas = 2;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Unknown argument %s!\n", arg);
+            fprintf(stderr, "Usage: %s [number of TAs] [--threads] [--lock=sysv|futex|ticket|mcs|robust] [--pin=compact|scatter|<cpu>,<cpu>...] [--exam-io=journal|rewrite|mmap|store] [--msync] [--checkpoint-ms=<ms>] [--rubric-flush-ms=<ms>] [--time-scale=<factor>] [--virtual-time] [--seed=<n>] [--log-format=text|json]\n", argv[0]);
+            fprintf(stderr, "       %s --import-exams | --export-exams\n", argv[0]);
+            fprintf(stderr, "       %s --generate-exams=<count> [--questions=<n>] [--sentinel-at=<index>]\n", argv[0]);
+            fprintf(stderr, "       %s --lock-bench=<max TAs> [--bench-format=csv|json]\n", argv[0]);
+            fprintf(stderr, "       %s --bench=<max TAs> [--bench-exams=<count>[,<count>...]] [--bench-format=csv|json] [--questions=<n>] [--sentinel-at=<index>]\n", argv[0]);
+            return -1;
+        }
+    }
 
-    int number_of_tas; // initialize variable for number of ta's to be used later
+    if (options->bench_max_tas > 0 && options->bench_pile_count == 0)
+    {
+        options->bench_exam_counts[0] = BENCH_DEFAULT_EXAMS;
+        options->bench_pile_count = 1;
+    }
 
-    if (argc != 2)
+    if (options->number_of_tas == 0 && options->store_command == STORE_COMMAND_NONE && options->bench_max_tas == 0 &&
+        options->lock_bench_max_tas == 0)
     {
         printf("Number of required arguments was not supplied!\n");
         printf("Defaulting to 2 TA's\n");
-        number_of_tas = 2;
+        options->number_of_tas = 2;
     }
-    else
-    {
-        number_of_tas = atoi(argv[1]);
 
-        if (number_of_tas < 2)
-        {
-            printf("Must have at least two TA's!\n. Defaulting to 2...\n");
-            number_of_tas = 2;
-        }
+    // a TA process can die holding an exam lock, ticket and mcs have no owner to check so its stripe would never be freed again
+    // a TA thread can't die on its own and --lock-bench never kills its processes, so only marking with TA processes is refused
+    if ((options->lock_backend == LOCK_BACKEND_TICKET || options->lock_backend == LOCK_BACKEND_MCS) &&
+        options->ta_mode == TA_MODE_PROCESSES && options->store_command == STORE_COMMAND_NONE && options->lock_bench_max_tas == 0)
+    {
+        fprintf(stderr, "--lock=%s can't recover from a TA process dying while holding it, use it with --threads or --lock-bench!\n",
+                lock_backend_name(options->lock_backend));
+        return -1;
     }
+    return 0;
+}
+
+/**
+ * @brief Mark every exam with options->number_of_tas TAs, this is what the marker does unless it was asked to do something else
+ * Creates the shared memory objects and the semaphore set, forks the logger and the TAs, supervises them until they are all done,
+ * then writes out the last marks and rubric corrections and prints how long it all took
+ *
+ * @param options The options the marker was started with
+ * @return int 0 once every exam is marked, 1 if marking could not be set up
+ */
+int run_marking(const marker_options *options)
+{
+    int number_of_tas = options->number_of_tas;
+
+    // with --pin= main() runs on the union of the TAs' CPUs while it creates and fills the shared memory objects, so under
+    // first touch the pages land on one of the TAs' NUMA nodes, best effort only, no page is placed for the particular TA using it
+    int *ta_cpus = plan_ta_placement(options, number_of_tas);
+    cpu_set_t main_cpus;
+    sched_getaffinity(0, sizeof(main_cpus), &main_cpus);
+    if (ta_cpus != NULL)
+        pin_to_cpus(ta_cpus, number_of_tas);
 
-    // Create a semaphore set with SEM_KEY (20254001) that contains 1 semaphore
-    int semaphore_id = semget(SEMAOPHORE_KEY, 1, IPC_CREAT | 0666);
-    if (semaphore_id == -1)
+    // one lock per stripe of exams, with the backend picked by --lock= (a SysV semaphore set by default)
+    exam_lock_set *exam_locks = createSharedMemExamLocks(options->lock_backend, number_of_tas, SEMAOPHORE_KEY);
+    if (!exam_locks)
     {
-        fprintf(stderr, "Failed to create the semaphore set...\n");
-        // we don't have to exit, part 2a showed the code can work without semaphore's, just may run into race conditions
+        fprintf(stderr, "Failed to create and/or map exam locks in shared memory!\n");
+        return 1;
     }
 
-    // Initialize semaphore to 1 --> unlocked
-    if (semaphore_id != -1)
+    // every TA records how long it waits for and holds locks, and how long loading, writing and marking exams takes
+    stats_block *stats = createSharedMemStats(number_of_tas);
+    if (!stats)
     {
-        if (semctl(semaphore_id, 0, SETVAL, 1) == -1)
-        {
-            fprintf(stderr, "Failed to initialize the semaphore (unlocked)...\n");
-            // we don't have to exit, part 2a showed the code can work without semaphore's, just may run into race conditions
-        }
+        fprintf(stderr, "Failed to create and/or map statistics block in shared memory!\n");
+        return 1;
     }
 
-    srand(time(NULL));
+    LOG_INFO("Random seed for this run is %llu, repeat it with --seed=%llu\n",
+           (unsigned long long)options->seed, (unsigned long long)options->seed);
     // *********************
     // on startup, load rubric and first exam into shared memory
     // create the rubric object in shared memory
@@ -863,27 +4599,253 @@ int main(int argc, char *argv[])
     }
     // *********************
 
+    // with the exam store every exam comes from one mapped file, otherwise every exam file in exams/ is read
     int exam_count;
-    char **exam_files = list_exams(&exam_count);
+    char **exam_files;
+    exam_store *store = NULL;
+    size_t store_size = 0;
+    if (options->exam_io_mode == EXAM_IO_STORE)
+    {
+        store = map_exam_store(&store_size);
+        if (store == NULL)
+            exit(1);
+        exam_count = store->exam_count;
+        exam_files = exam_store_names(store);
+    }
+    else
+    {
+        exam_files = list_exams(&exam_count);
+        if (exam_files == NULL)
+        {
+            fprintf(stderr, "Failed to list the exams to mark!\n");
+            return 1;
+        }
+    }
 
-    exam_file_shared_data *exam = createSharedMemExam("exam1");
-    if (!exam)
+    // one shared exam table holds every exam, each exam file is read exactly once here
+    exam_table_shared_data *table = createSharedMemExam(exam_count);
+    if (!table)
     {
-        fprintf(stderr, "Failed to create and/or map rubric in shared memory!\n");
+        fprintf(stderr, "Failed to create and/or map exam table in shared memory!\n");
+        exit(1);
+    }
+    if (store != NULL)
+        load_exam_table_from_store(table, store);
+    else if (load_exam_table(table, exam_files, &stats->sets[0]) == -1)
+        exit(1);
+
+    // marks are appended to the journal while TAs run, main() writes them into the exam files at checkpoints
+    int journal_fd = -1;
+    if (options->exam_io_mode == EXAM_IO_JOURNAL)
+    {
+        journal_fd = open_marking_journal(table, exam_files);
+        if (journal_fd == -1)
+            exit(1);
+    }
+
+    // in mmap mode every exam file stays mapped for the whole run and TAs mark questions straight into it
+    char **exam_maps = NULL;
+    if (options->exam_io_mode == EXAM_IO_MMAP)
+    {
+        exam_maps = map_exam_files(exam_files, exam_count);
+        if (exam_maps == NULL)
+            exit(1);
+    }
+
+    // the 9999 sentinel is found up front, the exams from it on are never handed to a TA
+    int sentinel_exam = find_runnable_prefix(table);
+    if (sentinel_exam != -1)
+    {
+        LOG_INFO(ANSI_COLOR_RED "\n------------STUDENT NUMBER 9999 FOUND ON %s------------" ANSI_COLOR_RESET "\n", exam_files[sentinel_exam]);
+        LOG_INFO("Only the %d exams before it will be marked, it and every exam after it (%d in all) are cut off\n",
+                 table->runnable_count, exam_count - table->runnable_count);
+    }
+
+    // every runnable exam goes into the work queue once, TAs pop exams from it instead of each walking the whole pile
+    exam_work_queue *queue = createSharedMemWorkQueue(exam_count);
+    if (!queue)
+    {
+        fprintf(stderr, "Failed to create and/or map work queue in shared memory!\n");
+        exit(1);
+    }
+    seed_exam_work_queue(queue, table->runnable_count);
+
+    // the 9999 sentinel stops the run through here, TAs check it before they take on more work
+    shutdown_state *shutdown = createSharedMemShutdown();
+    if (!shutdown)
+    {
+        fprintf(stderr, "Failed to create and/or map shutdown state in shared memory!\n");
+        exit(1);
+    }
+    shutdown->sentinel_exam = sentinel_exam;
+
+    // every TA gets its own deque of (exam, question) tasks that idle TAs can steal from
+    ta_task_deque *deques = createSharedMemTaskDeques(number_of_tas);
+    if (!deques)
+    {
+        fprintf(stderr, "Failed to create and/or map task deques in shared memory!\n");
+        exit(1);
+    }
+
+    // every simulated delay goes through the simulation clock, so the same run can be slept through, sped up or run in virtual time
+    simulation_clock *clock = createSharedMemClock(number_of_tas, options);
+    if (!clock)
+    {
+        fprintf(stderr, "Failed to create and/or map simulation clock in shared memory!\n");
+        exit(1);
+    }
+
+    // the shared memory objects are filled in, main(), the logger and the TAs' parent don't need to stay on the TAs' CPUs
+    if (ta_cpus != NULL)
+        sched_setaffinity(0, sizeof(main_cpus), &main_cpus);
+
+    // TAs push what they do onto their own event ring, the logger process does all the printing for them
+    event_log *events = createSharedMemEventLog(number_of_tas);
+    if (!events)
+    {
+        fprintf(stderr, "Failed to create and/or map event log in shared memory!\n");
         exit(1);
     }
+    pid_t logger_pid = create_logger_process(events, table, exam_files, options->log_format);
 
-    pid_t *ta_process_pids = create_ta_processes(number_of_tas, rubric, exam, exam_count, exam_files, semaphore_id);
+    unsigned long long marking_started = now_nanoseconds();
+    stats->marking_started_ns = marking_started;
+    ta_context ta_template = {
+        .ta_index = 0,
+        .num_ta_processes = number_of_tas,
+        .rubric = rubric,
+        .table = table,
+        .queue = queue,
+        .deques = deques,
+        .exam_files = exam_files,
+        .exam_locks = exam_locks,
+        .journal_fd = journal_fd,
+        .exam_maps = exam_maps,
+        .store = store,
+        .clock = clock,
+        .events = events,
+        .stats = stats,
+        .shutdown = shutdown,
+        .ta_cpus = ta_cpus,
+        .options = options,
+    };
+    pid_t *ta_process_pids = NULL;
+    ta_thread *ta_threads = NULL;
+    if (options->ta_mode == TA_MODE_THREADS)
+        ta_threads = create_ta_threads(&ta_template);
+    else
+        ta_process_pids = create_ta_processes(&ta_template);
 
-    // wait for all ta process to finish
-    for (int i = 0; i < number_of_tas; i++)
+    // wait for all ta process to finish, checkpointing the marking journal into the exam files while they run
+    int tas_running = number_of_tas;
+    unsigned long long next_checkpoint = now_nanoseconds() + (unsigned long long)options->checkpoint_ms * 1000000ULL;
+    unsigned long long next_rubric_flush = now_nanoseconds() + (unsigned long long)options->rubric_flush_ms * 1000000ULL;
+    while (tas_running > 0)
     {
-        waitpid(ta_process_pids[i], NULL, 0);
-        printf(ANSI_COLOR_RED "\n------------TERMINATING TA PROCESS------------" ANSI_COLOR_RESET "\n");
+        if (ta_threads != NULL)
+        {
+            int joined = join_finished_ta_threads(ta_threads, number_of_tas);
+            tas_running -= joined;
+            if (joined > 0)
+                continue;
+        }
+
+        // TA threads never show up here, the logger process only exits once we tell it to
+        pid_t pid = ta_threads != NULL ? 0 : waitpid(-1, NULL, WNOHANG);
+        if (pid > 0)
+        {
+            for (int i = 0; i < number_of_tas; i++)
+            {
+                if (ta_process_pids[i] != pid)
+                    continue;
+
+                LOG_INFO(ANSI_COLOR_RED "\n------------TERMINATING TA PROCESS------------" ANSI_COLOR_RESET "\n");
+
+                LOG_INFO("TA %d with PID %d has terminated.\n", i + 1, ta_process_pids[i]);
+                tas_running--;
+            }
+            continue;
+        }
+        if (pid == -1)
+            break; // no children left to wait for
+
+        if (journal_fd != -1 && now_nanoseconds() >= next_checkpoint)
+        {
+            checkpoint_exam_files(table, exam_files, journal_fd);
+            next_checkpoint = now_nanoseconds() + (unsigned long long)options->checkpoint_ms * 1000000ULL;
+        }
+        if (now_nanoseconds() >= next_rubric_flush)
+        {
+            flush_rubric(rubric);
+            next_rubric_flush = now_nanoseconds() + (unsigned long long)options->rubric_flush_ms * 1000000ULL;
+        }
+        usleep(SUPERVISOR_POLL_MICROSECONDS);
+    }
+    unsigned long long tas_stopped = now_nanoseconds();
 
-        printf("TA %d with PID %d has terminated.\n", i + 1, ta_process_pids[i]);
+    // let the logger print whatever the TAs logged last before we print anything else
+    atomic_store(&events->shutdown, 1);
+    waitpid(logger_pid, NULL, 0);
+
+    LOG_INFO(ANSI_COLOR_RED "\n------------MARKING TIME------------" ANSI_COLOR_RESET "\n");
+    LOG_INFO("Marking took %.3f seconds of real time\n", (now_nanoseconds() - marking_started) / 1e9);
+    if (clock->clock_mode == CLOCK_MODE_VIRTUAL)
+        LOG_INFO("Marking took %.3f seconds of virtual time (the TA that finished last)\n", virtual_makespan_ns(clock) / 1e9);
+    print_latency_stats(stats);
+    print_ta_placement(stats);
+    print_shutdown_latency(shutdown, stats, table, exam_files, tas_stopped);
+
+    // every TA is done (or stopped at the sentinel), write the last marks into the exam files and the last rubric corrections into rubric.txt
+    flush_rubric(rubric);
+    if (journal_fd != -1)
+        close_marking_journal(table, exam_files, journal_fd);
+    if (atomic_load(&exam_locks->lock_failures) > 0)
+    {
+        // some TAs could not take their exam lock and left their marks only in the exam table
+        int exams_rewritten = 0;
+        for (int stripe = 0; stripe < EXAM_LOCK_STRIPES; stripe++)
+            exams_rewritten += repair_exam_stripe(table, exam_files, stripe);
+        LOG_INFO("%d exam locks could not be taken, %d exam files were brought up to date with the exam table\n",
+                 atomic_load(&exam_locks->lock_failures), exams_rewritten);
     }
+    if (exam_maps != NULL)
+        unmap_exam_files(exam_maps, exam_count);
+    if (store != NULL)
+        unmap_exam_store(store, store_size);
+
     free(ta_process_pids); // free the ta process pid array from memory
+    free(ta_threads);
+    free(ta_cpus);
     free(exam_files);
+
+    // every TA is done with the exam locks, remove them so the next run starts clean
+    remove_exam_locks(exam_locks);
     return 0;
 }
+
+int main(int argc, char *argv[])
+{
+    setbuf(stdout, NULL); // print right away so nothing lags behind when checking printouts
+
+    marker_options options;
+    if (parse_arguments(argc, argv, &options) == -1)
+        return 1;
+
+    // converting between exams/ and the exam store doesn't need any TAs
+    if (options.store_command == STORE_COMMAND_IMPORT)
+        return import_exam_store() == -1 ? 1 : 0;
+    if (options.store_command == STORE_COMMAND_EXPORT)
+        return export_exam_store() == -1 ? 1 : 0;
+    if (options.store_command == STORE_COMMAND_GENERATE)
+        return generate_exam_store(options.generate_exam_count, options.questions_to_mark, options.sentinel_at) == -1 ? 1 : 0;
+
+    // the lock benchmark only needs the exam locks, not the rest of the marker
+    if (options.lock_bench_max_tas > 0)
+        return run_lock_benchmark(&options) == -1 ? 1 : 0;
+
+    // the benchmark runs the marker many times over, each run in a child process of its own
+    if (options.bench_max_tas > 0)
+        return run_benchmark(&options) == -1 ? 1 : 0;
+
+    return run_marking(&options);
+}